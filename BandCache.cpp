@@ -0,0 +1,218 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "BandCache.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <new>
+
+BandCacheKey::BandCacheKey()
+    : levels(0)
+    , fl(0)
+    , fh(0)
+    , filter(-1)
+    , precision(-1)
+    , frames(0)
+{
+}
+
+BandCacheKey::BandCacheKey(const std::string &input, int levels,
+                           float fl, float fh, int filter, int precision,
+                           long frames)
+    : input(input)
+    , levels(levels)
+    , fl(fl)
+    , fh(fh)
+    , filter(filter)
+    , precision(precision)
+    , frames(frames)
+{
+}
+
+bool BandCacheKey::operator==(const BandCacheKey &other) const
+{
+    return input == other.input && levels == other.levels
+            && fl == other.fl && fh == other.fh && filter == other.filter
+            && precision == other.precision && frames == other.frames;
+}
+
+BandCache::BandCache()
+    : stride(0)
+    , capacity(0)
+    , count(0)
+    , complete(false)
+    , base(0)
+{
+}
+
+/**
+ * create	-	start recording records
+ *
+ * @param key           -	what the records depend on
+ * @param layout        -	levels of a record, only their shapes are used,
+ *                          empty levels are not stored
+ * @param capacity      -	number of records
+ * @param memoryLimit	-	bytes allowed in RAM, a scratch file is used beyond
+ * @param scratchDir	-	directory of the scratch file
+ *
+ * @return true if the storage could be allocated
+ */
+bool BandCache::create(const BandCacheKey &key, const std::vector<cv::Mat> &layout,
+                       long capacity, size_t memoryLimit, const std::string &scratchDir)
+{
+    clear();
+    if (capacity <= 0)
+        return false;
+
+    stride = 0;
+    for (size_t l = 0; l < layout.size(); ++l) {
+        sizes.push_back(layout[l].size());
+        types.push_back(layout[l].type());
+        offsets.push_back(stride);
+        stride += cv::alignSize(layout[l].total() * layout[l].elemSize(), 64);
+    }
+
+    if (stride == 0 || (size_t)capacity > SIZE_MAX / stride) {
+        clear();
+        return false;
+    }
+    size_t bytes = stride * capacity;
+    if (memoryLimit == 0 || bytes <= memoryLimit) {
+        try {
+            memory.resize(bytes);
+        } catch (const std::bad_alloc &) {
+            perror("Failed to allocate the band cache");
+            clear();
+            return false;
+        }
+        base = &memory[0];
+    } else if (file.open(bytes, scratchDir)) {
+        base = file.data();
+    } else {
+        clear();
+        return false;
+    }
+
+    this->key = key;
+    this->capacity = capacity;
+    return true;
+}
+
+/**
+ * store	-	copy a record in
+ *
+ * @param index     -	index of the record, less than the capacity
+ * @param levels	-	levels of the record, shaped like the layout
+ *
+ * @return false if the record doesn't fit, the cache is then cleared
+ */
+bool BandCache::store(long index, const std::vector<cv::Mat> &levels)
+{
+    if (!base || index < 0 || index >= capacity || levels.size() != sizes.size()) {
+        clear();
+        return false;
+    }
+    std::vector<cv::Mat> views;
+    load(index, views);
+    for (size_t l = 0; l < levels.size(); ++l) {
+        if (sizes[l].area() == 0)
+            continue;
+        if (levels[l].size() != sizes[l] || levels[l].type() != types[l]) {
+            clear();
+            return false;
+        }
+        levels[l].copyTo(views[l]);
+    }
+    count = std::max(count, index + 1);
+    return true;
+}
+
+/**
+ * finish	-	all the records have been stored
+ *
+ * @param count	-	number of records of the run
+ */
+void BandCache::finish(long count)
+{
+    complete = base && count > 0 && count == this->count;
+    if (!complete)
+        clear();
+}
+
+/**
+ * load	-	views of a record
+ *
+ * The views stay valid until the cache is cleared or re-created.
+ *
+ * @param index     -	index of the record
+ * @param levels	-	destinate views
+ */
+void BandCache::load(long index, std::vector<cv::Mat> &levels) const
+{
+    levels.resize(sizes.size());
+    unsigned char *record = base + stride * index;
+    for (size_t l = 0; l < sizes.size(); ++l) {
+        if (sizes[l].area() == 0)
+            levels[l] = cv::Mat();
+        else
+            levels[l] = cv::Mat(sizes[l], types[l], record + offsets[l]);
+    }
+}
+
+/**
+ * clear	-	forget the records and free the storage
+ *
+ */
+void BandCache::clear()
+{
+    key = BandCacheKey();
+    sizes.clear();
+    types.clear();
+    offsets.clear();
+    stride = 0;
+    capacity = 0;
+    count = 0;
+    complete = false;
+    // swap, as clear() would keep the capacity
+    std::vector<unsigned char>().swap(memory);
+    file.close();
+    base = 0;
+}
+
+/**
+ * matches	-	are complete records of a key available
+ *
+ * @param key	-	the key
+ *
+ * @return true if they are
+ */
+bool BandCache::matches(const BandCacheKey &key) const
+{
+    return complete && this->key == key;
+}
+
+/**
+ * length	-	number of records
+ *
+ * @return the number of stored records
+ */
+long BandCache::length() const
+{
+    return count;
+}
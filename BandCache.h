@@ -0,0 +1,107 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef BANDCACHE_H
+#define BANDCACHE_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "ScratchFile.h"
+
+// what the bandpassed levels depend on
+struct BandCacheKey {
+    BandCacheKey();
+    BandCacheKey(const std::string &input, int levels, float fl, float fh, int filter,
+                 int precision, long frames);
+    bool operator==(const BandCacheKey &other) const;
+
+    // source video file
+    std::string input;
+    // levels of the pyramids
+    int levels;
+    // temporal cut-offs
+    float fl;
+    float fh;
+    // temporal filter type
+    int filter;
+    // storage precision of the filter states and frames
+    int precision;
+    // number of frames of the source
+    long frames;
+};
+
+/**
+ * BandCache	-	bandpassed levels of the last magnification
+ *
+ * Amplification, reconstruction and attenuation come after the
+ * temporal filter and are linear, so the filtered levels of a run
+ * can be re-used when only alpha, lambda_c or chromAttenuation
+ * change. A record holds the levels of one frame (motion) or the
+ * whole filtered time series (color). Records are stored back to
+ * back, in RAM or in a scratch file if they exceed the memory limit.
+ */
+class BandCache {
+public:
+    BandCache();
+
+    // start recording, the shapes and types of the records are those of layout
+    bool create(const BandCacheKey &key, const std::vector<cv::Mat> &layout,
+                long capacity, size_t memoryLimit, const std::string &scratchDir);
+
+    // copy a record in
+    bool store(long index, const std::vector<cv::Mat> &levels);
+
+    // all the records have been stored
+    void finish(long count);
+
+    // views of a record
+    void load(long index, std::vector<cv::Mat> &levels) const;
+
+    // forget the records
+    void clear();
+
+    // are complete records of key available
+    bool matches(const BandCacheKey &key) const;
+
+    // number of records
+    long length() const;
+
+private:
+    BandCache(const BandCache &);
+    BandCache &operator=(const BandCache &);
+
+    BandCacheKey key;
+    // shape and type of each level of a record
+    std::vector<cv::Size> sizes;
+    std::vector<int> types;
+    // byte offset of each level in a record
+    std::vector<size_t> offsets;
+    size_t stride;
+    long capacity;
+    long count;
+    bool complete;
+    // storage in RAM, sized beyond what a cv::Mat row can hold
+    std::vector<unsigned char> memory;
+    // storage on disk
+    ScratchFile file;
+    unsigned char *base;
+};
+
+#endif // BANDCACHE_H
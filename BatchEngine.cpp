@@ -0,0 +1,360 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "BatchEngine.h"
+#include "VideoProcessor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+MagnifyJob::MagnifyJob()
+  : mode(MOTION_MAGNIFY)
+  , alpha(10)
+  , lambda_c(80)
+  , fl(0.05)
+  , fh(0.4)
+  , chromAttenuation(0.1)
+  , levels(4)
+  , precision(FULL_PRECISION)
+  , motionFilter(LAPLACIAN)
+  , colorFilter(IDEAL)
+  , filterOrder(2)
+  , streaming(false)
+{
+}
+
+BatchEngine::BatchEngine()
+  : next(0)
+  , failed(0)
+  , maxThreads(0)
+  , memoryLimit(0)
+  , profiler(new StageProfiler)
+{
+}
+
+/**
+ * setMaxThreads	-	set the total number of threads of the jobs
+ *
+ * @param threads	-	number of threads, 0 for the number of cores
+ */
+void BatchEngine::setMaxThreads(int threads)
+{
+    maxThreads = std::max(threads, 0);
+}
+
+/**
+ * setMemoryLimit	-	set the total memory of the jobs
+ *
+ * Each worker gets an equal share, color magnification spills
+ * to scratch files beyond it (see VideoProcessor::setMemoryLimit).
+ *
+ * @param bytes	-	memory in bytes, 0 for half of the physical memory
+ */
+void BatchEngine::setMemoryLimit(size_t bytes)
+{
+    memoryLimit = bytes;
+}
+
+/**
+ * getProfiler	-	the stage timings of all the jobs
+ *
+ * @return the profiler, each worker thread is a track of its trace
+ */
+std::shared_ptr<StageProfiler> BatchEngine::getProfiler()
+{
+    return profiler;
+}
+
+/**
+ * addJob	-	queue a job
+ *
+ * @param job	-	the job
+ */
+void BatchEngine::addJob(const MagnifyJob &job)
+{
+    jobs.push_back(job);
+}
+
+/**
+ * parseParameter	-	parse a job parameter
+ *
+ * Known keys are mode (motion or color), alpha, lambda_c,
+ * fl, fh, chrom, levels, precision (full, half or fixed),
+ * pyramid (laplacian or riesz), filter (ideal or butterworth),
+ * order and streaming (on or off).
+ *
+ * @param parameter	-	the parameter, as key=value
+ * @param job	-	the job to set it on
+ *
+ * @return true if the parameter is valid
+ */
+bool BatchEngine::parseParameter(const std::string &parameter, MagnifyJob &job)
+{
+    size_t eq = parameter.find('=');
+    if (eq == std::string::npos)
+        return false;
+    std::string key = parameter.substr(0, eq);
+    std::string value = parameter.substr(eq + 1);
+    if (value.empty())
+        return false;
+
+    if (key == "mode") {
+        if (value == "motion")
+            job.mode = MOTION_MAGNIFY;
+        else if (value == "color")
+            job.mode = COLOR_MAGNIFY;
+        else
+            return false;
+        return true;
+    }
+    if (key == "precision") {
+        if (value == "full")
+            job.precision = FULL_PRECISION;
+        else if (value == "half")
+            job.precision = HALF_PRECISION;
+        else if (value == "fixed")
+            job.precision = FIXED_PRECISION;
+        else
+            return false;
+        return true;
+    }
+    if (key == "pyramid") {
+        if (value == "laplacian")
+            job.motionFilter = LAPLACIAN;
+        else if (value == "riesz")
+            job.motionFilter = RIESZ;
+        else
+            return false;
+        return true;
+    }
+    if (key == "filter") {
+        if (value == "ideal")
+            job.colorFilter = IDEAL;
+        else if (value == "butterworth")
+            job.colorFilter = BUTTERWORTH;
+        else
+            return false;
+        return true;
+    }
+    if (key == "streaming") {
+        if (value == "on" || value == "1")
+            job.streaming = true;
+        else if (value == "off" || value == "0")
+            job.streaming = false;
+        else
+            return false;
+        return true;
+    }
+
+    char *end;
+    double number = strtod(value.c_str(), &end);
+    if (*end != '\0')
+        return false;
+    if (key == "alpha")
+        job.alpha = number;
+    else if (key == "lambda_c")
+        job.lambda_c = number;
+    else if (key == "fl")
+        job.fl = number;
+    else if (key == "fh")
+        job.fh = number;
+    else if (key == "chrom")
+        job.chromAttenuation = number;
+    else if (key == "levels" && number >= 1)
+        job.levels = (int)number;
+    else if (key == "order" && number >= 1 && number <= 8)
+        job.filterOrder = (int)number;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * loadManifest	-	queue the jobs of a manifest file
+ *
+ * One job per line: the input file, the output file and then
+ * optional key=value parameters (see parseParameter). Empty
+ * lines and lines starting with '#' are skipped.
+ *
+ * @param fileName	-	the manifest file
+ * @param defaults	-	parameters of the jobs which don't set them
+ *
+ * @return true if every line is valid, no job is queued otherwise
+ */
+bool BatchEngine::loadManifest(const std::string &fileName, const MagnifyJob &defaults)
+{
+    std::ifstream manifest(fileName.c_str());
+    if (!manifest) {
+        perror(fileName.c_str());
+        return false;
+    }
+
+    std::vector<MagnifyJob> loaded;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(manifest, line)) {
+        ++lineNumber;
+        std::istringstream fields(line);
+        MagnifyJob job = defaults;
+        if (!(fields >> job.input) || job.input[0] == '#')
+            continue;
+        bool valid = (bool)(fields >> job.output);
+        std::string parameter;
+        while (valid && fields >> parameter)
+            valid = parseParameter(parameter, job);
+        if (!valid) {
+            fprintf(stderr, "%s:%d: invalid job\n", fileName.c_str(), lineNumber);
+            return false;
+        }
+        loaded.push_back(job);
+    }
+    jobs.insert(jobs.end(), loaded.begin(), loaded.end());
+    return true;
+}
+
+/**
+ * count	-	number of queued jobs
+ *
+ * @return the number of jobs
+ */
+size_t BatchEngine::count() const
+{
+    return jobs.size();
+}
+
+/**
+ * run	-	run all the queued jobs
+ *
+ * Each running job takes JOB_THREADS of the threads, the OpenCV
+ * pool, which all the jobs share, gets the rest. Every job gets an
+ * equal share of the memory.
+ *
+ * @return the number of failed jobs
+ */
+int BatchEngine::run()
+{
+    if (jobs.empty())
+        return 0;
+
+    int threads = maxThreads;
+    if (threads == 0)
+        threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    int workers = std::min(std::max(threads / JOB_THREADS, 1), (int)jobs.size());
+    size_t memory = memoryLimit ? memoryLimit : ScratchFile::physicalMemory() / 2;
+
+    // the OpenCV thread pool is shared by all the jobs, the
+    // magnifier thread calling into it counts as one of its threads
+    cv::setNumThreads(std::max(threads - workers * JOB_THREADS, 0) + 1);
+
+    next = 0;
+    failed = 0;
+    std::vector<std::thread> pool;
+    for (int i = 0; i < workers; ++i)
+        pool.push_back(std::thread(&BatchEngine::worker, this, memory / workers));
+    for (size_t i = 0; i < pool.size(); ++i)
+        pool[i].join();
+
+    jobs.clear();
+    return failed;
+}
+
+/**
+ * worker	-	take jobs until there are none left
+ *
+ * @param memory	-	memory share of the worker
+ */
+void BatchEngine::worker(size_t memory)
+{
+    while (true) {
+        size_t i = next++;
+        if (i >= jobs.size())
+            break;
+        if (!runJob(jobs[i], memory))
+            ++failed;
+    }
+}
+
+/**
+ * runJob	-	magnify one video and write the result
+ *
+ * @param job	-	the job
+ * @param memory	-	memory the job may use
+ *
+ * @return true if success
+ */
+bool BatchEngine::runJob(const MagnifyJob &job, size_t memory)
+{
+    VideoProcessor processor;
+    processor.setProfiler(profiler);
+    if (!processor.setInput(job.input)) {
+        report(job, "can't open the input");
+        return false;
+    }
+    processor.setAlpha(job.alpha);
+    processor.setLambdaC(job.lambda_c);
+    processor.setCutoffs(job.fl, job.fh);
+    processor.setChromAttenuation(job.chromAttenuation);
+    processor.setLevels(job.levels);
+    processor.setPrecision(job.precision);
+    processor.setMotionFilter(job.motionFilter);
+    processor.setColorFilter(job.colorFilter);
+    processor.setFilterOrder(job.filterOrder);
+    processor.setStreaming(job.streaming);
+    processor.setMemoryLimit(memory);
+    // encode the result once, straight into the output
+    processor.setDirectOutput(job.output);
+
+    report(job, "started");
+    processor.clearCancel();
+    if (job.mode == COLOR_MAGNIFY)
+        processor.colorMagnify();
+    else
+        processor.motionMagnify();
+
+    // the output is now the input, unless it couldn't be written
+    bool ok = processor.isModified() && processor.isOpened();
+
+    // remove the temp files of the job
+    std::string temp;
+    while (true) {
+        processor.getTempFile(temp);
+        if (temp.empty())
+            break;
+        remove(temp.c_str());
+    }
+
+    report(job, ok ? "done" : "can't write the output");
+    return ok;
+}
+
+/**
+ * report	-	print a message of a job
+ *
+ * @param job	-	the job
+ * @param message	-	the message
+ */
+void BatchEngine::report(const MagnifyJob &job, const char *message)
+{
+    std::lock_guard<std::mutex> lock(reportMutex);
+    printf("%s -> %s: %s\n", job.input.c_str(), job.output.c_str(), message);
+    fflush(stdout);
+}
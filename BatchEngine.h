@@ -0,0 +1,130 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef BATCHENGINE_H
+#define BATCHENGINE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <memory>
+#include "StageProfiler.h"
+#include "VideoProcessor.h"
+
+enum magnifyMode {MOTION_MAGNIFY, COLOR_MAGNIFY};
+
+// a magnification job of the batch engine
+struct MagnifyJob {
+    MagnifyJob();
+
+    // source and destinate video files
+    std::string input;
+    std::string output;
+    // motion or color magnification
+    magnifyMode mode;
+    // amplification factor
+    float alpha;
+    // cut-off wavelength
+    float lambda_c;
+    // low and high cut-offs
+    float fl;
+    float fh;
+    // chromatic attenuation
+    float chromAttenuation;
+    // levels of the spatial pyramids
+    int levels;
+    // precision of the IIR states and the buffered frames
+    storagePrecision precision;
+    // pyramid of motion magnification, LAPLACIAN or RIESZ
+    spatialFilterType motionFilter;
+    // temporal filter of color magnification, IDEAL or BUTTERWORTH
+    temporalFilterType colorFilter;
+    // order of the Butterworth filter
+    int filterOrder;
+    // stream color magnification in bounded windows
+    bool streaming;
+};
+
+// threads of a running job besides the OpenCV pool:
+// the magnifier, the decoder and the encoder
+static const int JOB_THREADS = 3;
+
+/**
+ * BatchEngine	-	runs magnification jobs without a GUI
+ *
+ * The jobs run concurrently on a pool of workers. The thread and
+ * memory limits are shared out between the workers, so that all
+ * the jobs together stay within them. A job uses JOB_THREADS
+ * threads at least, so fewer than that still run one job.
+ */
+class BatchEngine {
+public:
+    BatchEngine();
+
+    // set the total number of threads, 0 for the number of cores
+    void setMaxThreads(int threads);
+
+    // set the total memory of the jobs in bytes,
+    // 0 for half of the physical memory
+    void setMemoryLimit(size_t bytes);
+
+    // the stage timings of all the jobs, disabled by default
+    std::shared_ptr<StageProfiler> getProfiler();
+
+    // queue a job
+    void addJob(const MagnifyJob &job);
+
+    // queue the jobs of a manifest file
+    bool loadManifest(const std::string &fileName, const MagnifyJob &defaults);
+
+    // parse a key=value job parameter
+    static bool parseParameter(const std::string &parameter, MagnifyJob &job);
+
+    // number of queued jobs
+    size_t count() const;
+
+    // run all the queued jobs, return the number of failed ones
+    int run();
+
+private:
+    // take jobs until there are none left
+    void worker(size_t memory);
+
+    // run one job
+    bool runJob(const MagnifyJob &job, size_t memory);
+
+    // print a message of a job
+    void report(const MagnifyJob &job, const char *message);
+
+    std::vector<MagnifyJob> jobs;
+    // next job to take
+    std::atomic<size_t> next;
+    // number of failed jobs
+    std::atomic<int> failed;
+    int maxThreads;
+    size_t memoryLimit;
+    // shared by the processors of the jobs
+    std::shared_ptr<StageProfiler> profiler;
+    // serializes the messages of the workers
+    std::mutex reportMutex;
+};
+
+#endif // BATCHENGINE_H
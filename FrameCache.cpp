@@ -0,0 +1,165 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "FrameCache.h"
+#include <stdlib.h>
+
+// bytes of a frame
+static size_t frameBytes(const cv::Mat &frame)
+{
+    return frame.total() * frame.elemSize();
+}
+
+FrameCache::FrameCache(size_t budget)
+    : budget(budget)
+    , used(0)
+    , hitCount(0)
+    , missCount(0)
+{
+}
+
+/**
+ * setBudget	-	set the most bytes of frames to keep
+ *
+ * @param bytes	-	the budget, 0 disables the cache
+ */
+void FrameCache::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    budget = bytes;
+    evict();
+}
+
+/**
+ * get	-	look a frame up
+ *
+ * @param index	-	frame index
+ * @param frame	-	the frame if found, shared with the cache
+ *
+ * @return true if the frame is cached
+ */
+bool FrameCache::get(long index, cv::Mat &frame)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<long, Entries::iterator>::iterator it = lookup.find(index);
+    if (it == lookup.end()) {
+        ++missCount;
+        return false;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    frame = it->second->second;
+    ++hitCount;
+    return true;
+}
+
+/**
+ * nearest	-	the cached frame nearest to an index
+ *
+ * Used as a stand-in while the exact frame is decoded. Does not
+ * count as a lookup nor mark the frame as used.
+ *
+ * @param index     -	frame index
+ * @param distance	-	the farthest a frame may be
+ * @param frame     -	the frame if found, shared with the cache
+ *
+ * @return the index of the frame, -1 if there is none
+ */
+long FrameCache::nearest(long index, long distance, cv::Mat &frame)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<long, Entries::iterator>::iterator after = lookup.lower_bound(index);
+    std::map<long, Entries::iterator>::iterator best = lookup.end();
+    if (after != lookup.end())
+        best = after;
+    if (after != lookup.begin()) {
+        std::map<long, Entries::iterator>::iterator before = after;
+        --before;
+        if (best == lookup.end() || index - before->first < best->first - index)
+            best = before;
+    }
+    if (best == lookup.end() || std::labs(best->first - index) > distance)
+        return -1;
+    frame = best->second->second;
+    return best->first;
+}
+
+/**
+ * put	-	add or replace a frame
+ *
+ * Frames larger than the whole budget are not kept.
+ *
+ * @param index	-	frame index
+ * @param frame	-	the frame, shared with the cache
+ */
+void FrameCache::put(long index, const cv::Mat &frame)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    size_t bytes = frameBytes(frame);
+    if (frame.empty() || bytes > budget)
+        return;
+
+    std::map<long, Entries::iterator>::iterator it = lookup.find(index);
+    if (it != lookup.end()) {
+        used -= frameBytes(it->second->second);
+        entries.erase(it->second);
+    }
+    entries.push_front(std::make_pair(index, frame));
+    lookup[index] = entries.begin();
+    used += bytes;
+    evict();
+}
+
+/**
+ * clear	-	forget all the frames
+ *
+ */
+void FrameCache::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+    lookup.clear();
+    used = 0;
+}
+
+size_t FrameCache::size() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return used;
+}
+
+long FrameCache::hits() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return hitCount;
+}
+
+long FrameCache::misses() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return missCount;
+}
+
+void FrameCache::evict()
+{
+    while (used > budget && !entries.empty()) {
+        used -= frameBytes(entries.back().second);
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
@@ -0,0 +1,84 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <cstddef>
+#include <opencv2/core/core.hpp>
+
+/**
+ * FrameCache	-	decoded frames around the playhead
+ *
+ * Frames are kept by index, least recently used first out, within
+ * a budget in bytes. The frames are shared, not copied, so a frame
+ * must not be written to once it is put. Safe to use from the
+ * player thread and the GUI thread at once.
+ */
+class FrameCache {
+public:
+    explicit FrameCache(size_t budget = 0);
+
+    // set the budget in bytes, 0 disables the cache
+    void setBudget(size_t bytes);
+
+    // look a frame up, marking it as recently used
+    bool get(long index, cv::Mat &frame);
+
+    // the cached frame nearest to an index, within a distance
+    // return its index, or -1 if there is none
+    long nearest(long index, long distance, cv::Mat &frame);
+
+    // add or replace a frame
+    void put(long index, const cv::Mat &frame);
+
+    // forget all the frames
+    void clear();
+
+    // bytes held
+    size_t size() const;
+
+    // number of lookups found and not found
+    long hits() const;
+    long misses() const;
+
+private:
+    FrameCache(const FrameCache &);
+    FrameCache &operator=(const FrameCache &);
+
+    // drop the least recently used frames down to the budget
+    void evict();
+
+    typedef std::list<std::pair<long, cv::Mat> > Entries;
+
+    // most recently used first
+    Entries entries;
+    std::map<long, Entries::iterator> lookup;
+    size_t budget;
+    size_t used;
+    long hitCount;
+    long missCount;
+    mutable std::mutex lock;
+};
+
+#endif // FRAMECACHE_H
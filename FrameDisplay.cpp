@@ -0,0 +1,184 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "FrameDisplay.h"
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+
+FrameDisplay::FrameDisplay(QObject *parent)
+    : QObject(parent)
+    , quit(false)
+    , width(0)
+    , height(0)
+    , front(0)
+    , fresh(false)
+    , drops(0)
+{
+    worker = std::thread(&FrameDisplay::run, this);
+}
+
+FrameDisplay::~FrameDisplay()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+/**
+ * submit	-	show a frame
+ *
+ * A frame still waiting for the worker is dropped.
+ *
+ * @param frame     -	BGR (or gray) CV_8U frame
+ * @param width     -	width to fit the frame in, 0 for no scaling
+ * @param height	-	height to fit the frame in, 0 for no scaling
+ */
+void FrameDisplay::submit(const cv::Mat &frame, int width, int height)
+{
+    if (frame.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!pending.empty())
+            ++drops;
+        pending = frame;
+        this->width = width;
+        this->height = height;
+    }
+    wake.notify_one();
+}
+
+/**
+ * take	-	take the latest converted frame
+ *
+ * Called on the GUI thread, as pixmaps belong there.
+ *
+ * @param pixmap	-	the frame
+ *
+ * @return true if there was a new frame
+ */
+bool FrameDisplay::take(QPixmap &pixmap)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fresh)
+        return false;
+    // the worker doesn't touch the front buffer while we hold the lock
+    pixmap = QPixmap::fromImage(images[front]);
+    fresh = false;
+    return true;
+}
+
+/**
+ * dropped	-	number of frames dropped so far
+ *
+ * @return the number of frames which were never shown
+ */
+long FrameDisplay::dropped() const
+{
+    return drops.load();
+}
+
+/**
+ * run	-	convert the pending frames until destroyed
+ *
+ */
+void FrameDisplay::run()
+{
+    while (true) {
+        cv::Mat frame;
+        int w, h;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!quit && pending.empty())
+                wake.wait(lock);
+            if (quit)
+                return;
+            frame = pending;
+            pending = cv::Mat();
+            w = width;
+            h = height;
+        }
+
+        convert(frame, w, h);
+
+        bool notify;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            front = 1 - front;
+            // the previous frame was never taken, the
+            // ready() emitted for it brings this one instead
+            if (fresh)
+                ++drops;
+            notify = !fresh;
+            fresh = true;
+        }
+        if (notify)
+            emit ready();
+    }
+}
+
+/**
+ * convert	-	convert a frame into the back buffer
+ *
+ * The frame is scaled down (never up) to fit, keeping its aspect.
+ * With Qt 5.14 or later the QImage is BGR and an unscaled frame is
+ * not copied at all.
+ *
+ * @param frame     -	BGR (or gray) CV_8U frame
+ * @param width     -	width to fit the frame in
+ * @param height	-	height to fit the frame in
+ */
+void FrameDisplay::convert(const cv::Mat &frame, int width, int height)
+{
+    int back = 1 - front;
+    cv::Mat &buffer = pixels[back];
+
+    cv::Mat bgr = frame;
+    if (frame.channels() == 1)
+        cv::cvtColor(frame, bgr, CV_GRAY2BGR);
+
+    double scale = 1;
+    if (width > 0 && height > 0)
+        scale = std::min(1.0, std::min(double(width) / bgr.cols,
+                                       double(height) / bgr.rows));
+    cv::Size size(std::max(1, cvRound(bgr.cols * scale)),
+                  std::max(1, cvRound(bgr.rows * scale)));
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    if (size == bgr.size())
+        buffer = bgr;
+    else
+        cv::resize(bgr, buffer, size, 0, 0, cv::INTER_AREA);
+    images[back] = QImage(buffer.data, buffer.cols, buffer.rows,
+                          (int)buffer.step, QImage::Format_BGR888);
+#else
+    if (size == bgr.size()) {
+        cv::cvtColor(bgr, buffer, CV_BGR2RGB);
+    } else {
+        // scale first, so that fewer pixels are swapped
+        cv::resize(bgr, buffer, size, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(buffer, buffer, CV_BGR2RGB);
+    }
+    images[back] = QImage(buffer.data, buffer.cols, buffer.rows,
+                          (int)buffer.step, QImage::Format_RGB888);
+#endif
+}
@@ -0,0 +1,89 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef FRAMEDISPLAY_H
+#define FRAMEDISPLAY_H
+
+#include <QObject>
+#include <QImage>
+#include <QPixmap>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <opencv2/core/core.hpp>
+
+/**
+ * FrameDisplay	-	converts frames for display on a worker thread
+ *
+ * Frames are scaled down to the display size and wrapped in QImages
+ * there, so the GUI thread only turns a small image into a pixmap.
+ * There is one pending frame and two converted buffers: a newer
+ * frame replaces a pending or converted one that hasn't been shown
+ * yet, so a slow display drops frames instead of falling behind.
+ * ready() is emitted in the thread of the display.
+ */
+class FrameDisplay : public QObject {
+
+    Q_OBJECT
+
+public:
+    explicit FrameDisplay(QObject *parent = 0);
+    ~FrameDisplay();
+
+    // show a BGR frame scaled to fit width x height; the frame
+    // is kept by reference, so it must not be written afterwards
+    void submit(const cv::Mat &frame, int width, int height);
+
+    // take the latest converted frame, false if there is none
+    bool take(QPixmap &pixmap);
+
+    // number of frames dropped so far
+    long dropped() const;
+
+signals:
+    // a converted frame can be taken
+    void ready();
+
+private:
+    // convert the pending frames until destroyed
+    void run();
+
+    // convert a frame into the back buffer
+    void convert(const cv::Mat &frame, int width, int height);
+
+    std::thread worker;
+    // guards everything below but the back buffer
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit;
+    // frame waiting to be converted, and the size to fit it in
+    cv::Mat pending;
+    int width, height;
+    // pixels and images of the two buffers
+    cv::Mat pixels[2];
+    QImage images[2];
+    // the buffer the GUI thread reads, the other one is the worker's
+    int front;
+    // the front buffer hasn't been taken yet
+    bool fresh;
+    std::atomic<long> drops;
+};
+
+#endif // FRAMEDISPLAY_H
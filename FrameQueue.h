@@ -0,0 +1,229 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstddef>
+
+// usage statistics of a frame queue
+struct QueueStats {
+    // number of slots
+    size_t capacity;
+    // the deepest the queue has been
+    size_t maxDepth;
+    // average depth seen by the producer
+    double meanDepth;
+    // times the producer found the queue full
+    long pushStalls;
+    // times the consumer found the queue empty
+    long popStalls;
+};
+
+/**
+ * FrameQueue	-	bounded lock-free single-producer/single-consumer queue
+ *
+ * Used between the stages of the processing pipeline. Items come out
+ * in the order they went in. The blocking push()/pop() spin briefly,
+ * since a stage is rarely idle for long, then sleep until the other
+ * end makes progress, so that a stalled stage doesn't burn a core.
+ */
+template <typename T>
+class FrameQueue {
+public:
+    explicit FrameQueue(size_t capacity)
+        : ring(capacity + 1)
+        , head(0)
+        , tail(0)
+        , closed(false)
+        , cancelled(false)
+        , maxDepth(0)
+        , depthSum(0)
+        , pushes(0)
+        , pushStalls(0)
+        , popStalls(0)
+        , sleepers(0)
+    {
+    }
+
+    // add an item if there is room
+    bool tryPush(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) % ring.size();
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+        ring[t] = item;
+        tail.store(next, std::memory_order_release);
+        notify();
+
+        size_t d = depth();
+        if (d > maxDepth.load(std::memory_order_relaxed))
+            maxDepth.store(d, std::memory_order_relaxed);
+        depthSum.fetch_add(d, std::memory_order_relaxed);
+        pushes.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // take an item if there is one
+    bool tryPop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = ring[h];
+        // release the slot's reference
+        ring[h] = T();
+        head.store((h + 1) % ring.size(), std::memory_order_release);
+        notify();
+        return true;
+    }
+
+    // add an item, waiting for room
+    // return false if the queue has been cancelled
+    bool push(const T &item)
+    {
+        if (tryPush(item))
+            return true;
+        pushStalls.fetch_add(1, std::memory_order_relaxed);
+        for (int spins = 0; !cancelled.load(std::memory_order_acquire); ++spins) {
+            if (tryPush(item))
+                return true;
+            if (spins < SPINS)
+                std::this_thread::yield();
+            else
+                sleep(true);
+        }
+        return false;
+    }
+
+    // take an item, waiting for one
+    // return false once the queue is closed and drained, or cancelled
+    bool pop(T &item)
+    {
+        if (tryPop(item))
+            return true;
+        popStalls.fetch_add(1, std::memory_order_relaxed);
+        for (int spins = 0; !cancelled.load(std::memory_order_acquire); ++spins) {
+            if (tryPop(item))
+                return true;
+            if (closed.load(std::memory_order_acquire))
+                return tryPop(item);
+            if (spins < SPINS)
+                std::this_thread::yield();
+            else
+                sleep(false);
+        }
+        return false;
+    }
+
+    // the producer has no more items
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+        notify();
+    }
+
+    // wake up and fail both ends
+    void cancel()
+    {
+        cancelled.store(true, std::memory_order_release);
+        notify();
+    }
+
+    // number of queued items
+    size_t depth() const
+    {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        return (t + ring.size() - h) % ring.size();
+    }
+
+    // usage statistics so far
+    QueueStats stats() const
+    {
+        QueueStats s;
+        long n = pushes.load(std::memory_order_relaxed);
+        s.capacity = ring.size() - 1;
+        s.maxDepth = maxDepth.load(std::memory_order_relaxed);
+        s.meanDepth = n ? double(depthSum.load(std::memory_order_relaxed)) / n : 0.0;
+        s.pushStalls = pushStalls.load(std::memory_order_relaxed);
+        s.popStalls = popStalls.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    FrameQueue(const FrameQueue &);
+    FrameQueue &operator=(const FrameQueue &);
+
+    // yields of a blocked end before it sleeps
+    static const int SPINS = 64;
+
+    // sleep until there is room (producer) or an item (consumer),
+    // or the queue is closed or cancelled
+    void sleep(bool producer)
+    {
+        std::unique_lock<std::mutex> lock(sleepLock);
+        sleepers.fetch_add(1);
+        // pairs with the fence of notify(), so that either the other
+        // end sees the sleeper or the sleeper sees its progress
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!cancelled.load(std::memory_order_acquire)
+               && !closed.load(std::memory_order_acquire)
+               && (producer ? depth() == ring.size() - 1 : depth() == 0))
+            wake.wait(lock);
+        sleepers.fetch_sub(1);
+    }
+
+    // wake up the sleeping end, if any
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            wake.notify_all();
+        }
+    }
+
+    // ring buffer, one slot is always left empty
+    std::vector<T> ring;
+    // next slot to read, owned by the consumer
+    std::atomic<size_t> head;
+    // next slot to write, owned by the producer
+    std::atomic<size_t> tail;
+    std::atomic<bool> closed;
+    std::atomic<bool> cancelled;
+
+    std::atomic<size_t> maxDepth;
+    std::atomic<size_t> depthSum;
+    std::atomic<long> pushes;
+    std::atomic<long> pushStalls;
+    std::atomic<long> popStalls;
+
+    std::atomic<int> sleepers;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+};
+
+#endif // FRAMEQUEUE_H
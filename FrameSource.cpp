@@ -0,0 +1,228 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "FrameSource.h"
+
+FrameSource::FrameSource()
+    : pos(0)
+{
+}
+
+FrameSource::FrameSource(const std::string &fileName)
+    : pos(0)
+{
+    open(fileName);
+}
+
+/**
+ * open	-	open a video or a frame store
+ *
+ * @param fileName	-	the file
+ *
+ * @return True if success
+ */
+bool FrameSource::open(const std::string &fileName)
+{
+    release();
+    if (isFrameStore(fileName))
+        return store.open(fileName);
+    return capture.open(fileName);
+}
+
+/**
+ * isOpened	-	is a file open
+ *
+ * @return True if open
+ */
+bool FrameSource::isOpened() const
+{
+    return store.isOpened() || capture.isOpened();
+}
+
+/**
+ * release	-	close the file
+ *
+ */
+void FrameSource::release()
+{
+    store.release();
+    if (capture.isOpened())
+        capture.release();
+    pos = 0;
+}
+
+/**
+ * isStore	-	is it reading a frame store
+ *
+ * @return True for a frame store
+ */
+bool FrameSource::isStore() const
+{
+    return store.isOpened();
+}
+
+/**
+ * read	-	read the next frame
+ *
+ * @param frame	-	the frame
+ *
+ * @return True if success, false at the end
+ */
+bool FrameSource::read(cv::Mat &frame)
+{
+    if (!store.isOpened())
+        return capture.read(frame);
+    if (!store.read(pos, frame))
+        return false;
+    ++pos;
+    return true;
+}
+
+/**
+ * get	-	a property
+ *
+ * @param propId	-	CV_CAP_PROP_*
+ *
+ * @return the value, 0 if unsupported
+ */
+double FrameSource::get(int propId)
+{
+    if (!store.isOpened())
+        return capture.get(propId);
+
+    switch (propId) {
+    case CV_CAP_PROP_POS_FRAMES:
+        return pos;
+    case CV_CAP_PROP_POS_MSEC:
+        return store.fps() > 0 ? pos * 1000.0 / store.fps() : 0;
+    case CV_CAP_PROP_POS_AVI_RATIO:
+        return static_cast<double>(pos) / store.frames();
+    case CV_CAP_PROP_FRAME_COUNT:
+        return store.frames();
+    case CV_CAP_PROP_FPS:
+        return store.fps();
+    case CV_CAP_PROP_FRAME_WIDTH:
+        return store.size().width;
+    case CV_CAP_PROP_FRAME_HEIGHT:
+        return store.size().height;
+    case CV_CAP_PROP_FOURCC:
+        return FRAME_STORE_FOURCC;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * set	-	set a property
+ *
+ * Frame stores only support the position, which is set exactly.
+ *
+ * @param propId	-	CV_CAP_PROP_*
+ * @param value	-	the value
+ *
+ * @return True if success
+ */
+bool FrameSource::set(int propId, double value)
+{
+    if (!store.isOpened())
+        return capture.set(propId, value);
+
+    double frame;
+    switch (propId) {
+    case CV_CAP_PROP_POS_FRAMES:
+        frame = value;
+        break;
+    case CV_CAP_PROP_POS_MSEC:
+        frame = value * store.fps() / 1000.0;
+        break;
+    case CV_CAP_PROP_POS_AVI_RATIO:
+        frame = value * store.frames();
+        break;
+    default:
+        return false;
+    }
+    if (frame < 0 || frame > store.frames())
+        return false;
+    pos = cvRound(frame);
+    return true;
+}
+
+FrameSink::FrameSink()
+{
+}
+
+/**
+ * open	-	create a video or a frame store
+ *
+ * @param fileName	-	the file
+ * @param fourcc	-	codec of a video
+ * @param fps	-	frame rate
+ * @param size	-	frame size
+ * @param isColor	-	are the frames colorful
+ *
+ * @return True if success
+ */
+bool FrameSink::open(const std::string &fileName, int fourcc, double fps,
+                     cv::Size size, bool isColor)
+{
+    release();
+    if (isFrameStore(fileName))
+        return store.open(fileName, size, isColor ? CV_8UC3 : CV_8UC1, fps);
+    // a frame store can't be re-encoded as one
+    if (fourcc == FRAME_STORE_FOURCC)
+        fourcc = CV_FOURCC('M', 'J', 'P', 'G');
+    return writer.open(fileName, fourcc, fps, size, isColor);
+}
+
+/**
+ * isOpened	-	is a file open
+ *
+ * @return True if open
+ */
+bool FrameSink::isOpened() const
+{
+    return store.isOpened() || writer.isOpened();
+}
+
+/**
+ * release	-	close the file
+ *
+ */
+void FrameSink::release()
+{
+    store.release();
+    if (writer.isOpened())
+        writer.release();
+}
+
+/**
+ * write	-	append a frame
+ *
+ * @param frame	-	the frame
+ *
+ * @return False if a frame store could not write it. VideoWriter
+ *         reports no errors, only that it is not open
+ */
+bool FrameSink::write(const cv::Mat &frame)
+{
+    if (store.isOpened())
+        return store.write(frame);
+    writer.write(frame);
+    return writer.isOpened();
+}
@@ -0,0 +1,106 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "FrameStore.h"
+
+// fourcc reported for frame stores
+#define FRAME_STORE_FOURCC CV_FOURCC('E', 'V', 'M', 'F')
+
+/**
+ * FrameSource	-	cv::VideoCapture, or a frame store
+ *
+ * Files named *.evmf are read through a FrameStoreReader, which
+ * seeks exactly and without decoding; any other file through
+ * cv::VideoCapture. Supports the properties the processor uses.
+ */
+class FrameSource {
+public:
+    FrameSource();
+    explicit FrameSource(const std::string &fileName);
+
+    // open a video or a frame store
+    bool open(const std::string &fileName);
+
+    // is a file open
+    bool isOpened() const;
+
+    // close the file
+    void release();
+
+    // read the next frame
+    bool read(cv::Mat &frame);
+
+    // a CV_CAP_PROP_* property
+    double get(int propId);
+
+    // set a CV_CAP_PROP_* property
+    bool set(int propId, double value);
+
+    // is it reading a frame store
+    bool isStore() const;
+
+private:
+    FrameSource(const FrameSource &);
+    FrameSource &operator=(const FrameSource &);
+
+    cv::VideoCapture capture;
+    FrameStoreReader store;
+    // next frame of the store
+    long pos;
+};
+
+/**
+ * FrameSink	-	cv::VideoWriter, or a frame store
+ *
+ * Files named *.evmf are written as a frame store, whatever the
+ * codec. Other files are encoded by cv::VideoWriter, with MJPG in
+ * place of the fourcc of frame stores.
+ */
+class FrameSink {
+public:
+    FrameSink();
+
+    // create a video or a frame store
+    bool open(const std::string &fileName, int fourcc, double fps,
+              cv::Size size, bool isColor = true);
+
+    // is a file open
+    bool isOpened() const;
+
+    // close the file
+    void release();
+
+    // append a frame
+    bool write(const cv::Mat &frame);
+
+private:
+    FrameSink(const FrameSink &);
+    FrameSink &operator=(const FrameSink &);
+
+    cv::VideoWriter writer;
+    FrameStoreWriter store;
+};
+
+#endif // FRAMESOURCE_H
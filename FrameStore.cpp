@@ -0,0 +1,448 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "FrameStore.h"
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define EVM_HAVE_MMAP 1
+#endif
+
+#ifdef EVM_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+static const unsigned int STORE_VERSION = 1;
+
+/**
+ * seekTo	-	seek a file beyond 2GB
+ *
+ * @return True if success
+ */
+static bool seekTo(FILE *file, long long offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+/**
+ * fileLength	-	size of a file beyond 2GB
+ *
+ * @return the size in bytes, -1 on error
+ */
+static long long fileLength(FILE *file)
+{
+#if defined(_WIN32)
+    if (_fseeki64(file, 0, SEEK_END) != 0)
+        return -1;
+    return _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0)
+        return -1;
+    return ftello(file);
+#endif
+}
+
+/**
+ * rawBytes	-	size of an uncompressed frame of a store
+ */
+static size_t rawBytes(const FrameStoreHeader &header)
+{
+    return static_cast<size_t>(header.width) * header.height
+            * CV_ELEM_SIZE(header.type);
+}
+
+/**
+ * isFrameStore	-	is the name one of a frame store
+ *
+ * @param fileName	-	the file
+ *
+ * @return True if it has the extension of frame stores
+ */
+bool isFrameStore(const std::string &fileName)
+{
+    const std::string ext = FRAME_STORE_EXT;
+    return fileName.size() > ext.size()
+            && fileName.compare(fileName.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+FrameStoreWriter::FrameStoreWriter()
+    : file(0)
+    , offset(0)
+{
+}
+
+FrameStoreWriter::~FrameStoreWriter()
+{
+    release();
+}
+
+/**
+ * canCompress	-	can chunks be compressed in this build
+ *
+ * @return True if built with LZ4
+ */
+bool FrameStoreWriter::canCompress()
+{
+#ifdef EVM_HAVE_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * open	-	create the store
+ *
+ * @param fileName	-	the file, which is overwritten
+ * @param size	-	size of the frames
+ * @param type	-	type of the frames
+ * @param fps	-	frame rate
+ * @param compress	-	compress the frames if the build can
+ *
+ * @return True if success
+ */
+bool FrameStoreWriter::open(const std::string &fileName, cv::Size size, int type,
+                            double fps, bool compress)
+{
+    release();
+    if (size.width <= 0 || size.height <= 0)
+        return false;
+    file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        perror("Can't create frame store");
+        return false;
+    }
+    // chunks are large, and a failed write must be seen at once
+    setvbuf(file, 0, _IONBF, 0);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "EVMF", 4);
+    header.version = STORE_VERSION;
+    header.width = size.width;
+    header.height = size.height;
+    header.type = type;
+    header.compressed = compress && canCompress();
+    header.fps = fps;
+    index.clear();
+
+    // the header is written again with the index
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        perror("Can't write frame store");
+        fclose(file);
+        file = 0;
+        return false;
+    }
+    offset = sizeof(header);
+    return true;
+}
+
+/**
+ * isOpened	-	is a store open
+ *
+ * @return True if open
+ */
+bool FrameStoreWriter::isOpened() const
+{
+    return file != 0;
+}
+
+/**
+ * write	-	append a frame
+ *
+ * @param frame	-	a frame of the size and type of the store
+ *
+ * @return True if written. False otherwise, e.g. on a full disk;
+ *         the frames before it are kept
+ */
+bool FrameStoreWriter::write(const cv::Mat &frame)
+{
+    if (!file || frame.cols != header.width || frame.rows != header.height
+            || frame.type() != header.type)
+        return false;
+
+    cv::Mat data = frame.isContinuous() ? frame : frame.clone();
+    size_t raw = rawBytes(header);
+    const char *chunk = reinterpret_cast<const char *>(data.data);
+    size_t size = raw;
+#ifdef EVM_HAVE_LZ4
+    if (header.compressed) {
+        buffer.resize(LZ4_compressBound(static_cast<int>(raw)));
+        int packed = LZ4_compress_default(chunk, &buffer[0],
+                                          static_cast<int>(raw),
+                                          static_cast<int>(buffer.size()));
+        // incompressible frames are kept raw
+        if (packed > 0 && static_cast<size_t>(packed) < raw) {
+            chunk = &buffer[0];
+            size = packed;
+        }
+    }
+#endif
+    if (fwrite(chunk, 1, size, file) != size) {
+        perror("Can't write frame store");
+        // drop the partial chunk, the index goes after the last good one
+        seekTo(file, offset);
+        return false;
+    }
+    FrameStoreChunk entry;
+    entry.offset = offset;
+    entry.size = size;
+    index.push_back(entry);
+    offset += size;
+    return true;
+}
+
+/**
+ * release	-	write the index and close the store
+ *
+ */
+void FrameStoreWriter::release()
+{
+    if (!file)
+        return;
+    header.frames = index.size();
+    header.indexOffset = offset;
+    // right after the last good chunk
+    bool ok = seekTo(file, offset);
+    ok = ok && (index.empty()
+            || fwrite(&index[0], sizeof(FrameStoreChunk), index.size(), file) == index.size());
+    ok = ok && seekTo(file, 0)
+            && fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!ok)
+        perror("Can't write frame store index");
+    fclose(file);
+    file = 0;
+    index.clear();
+    buffer.clear();
+}
+
+FrameStoreReader::FrameStoreReader()
+    : file(0)
+    , map(0)
+    , mapSize(0)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+FrameStoreReader::~FrameStoreReader()
+{
+    release();
+}
+
+/**
+ * open	-	open a complete store
+ *
+ * @param fileName	-	the file
+ *
+ * @return True if success. False if the file is not a store,
+ *         or was not released by its writer
+ */
+bool FrameStoreReader::open(const std::string &fileName)
+{
+    release();
+    file = fopen(fileName.c_str(), "rb");
+    if (!file)
+        return false;
+    long long length = fileLength(file);
+
+#ifdef EVM_HAVE_MMAP
+    if (length > 0) {
+        void *p = mmap(0, length, PROT_READ, MAP_SHARED, fileno(file), 0);
+        if (p != MAP_FAILED) {
+            map = static_cast<const char *>(p);
+            mapSize = length;
+            // the mapping keeps the file alive
+            fclose(file);
+            file = 0;
+        }
+    }
+#endif
+
+    if (!fetch(0, sizeof(header), reinterpret_cast<char *>(&header))
+            || memcmp(header.magic, "EVMF", 4) != 0
+            || header.version != STORE_VERSION
+            || header.frames <= 0
+            || header.width <= 0 || header.height <= 0) {
+        release();
+        return false;
+    }
+#ifndef EVM_HAVE_LZ4
+    if (header.compressed) {
+        fprintf(stderr, "Frame store %s needs LZ4\n", fileName.c_str());
+        release();
+        return false;
+    }
+#endif
+
+    // a damaged header must not size the index
+    long long indexOffset = header.indexOffset;
+    if (indexOffset < (long long)sizeof(header) || indexOffset > length
+            || header.frames > (length - indexOffset) / (long long)sizeof(FrameStoreChunk)) {
+        release();
+        return false;
+    }
+    index.resize(header.frames);
+    if (!fetch(header.indexOffset, index.size() * sizeof(FrameStoreChunk),
+               reinterpret_cast<char *>(&index[0]))) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * fetch	-	copy bytes of the file
+ *
+ * @param offset	-	offset in the file
+ * @param bytes	-	number of bytes
+ * @param dst	-	destination
+ *
+ * @return True if the bytes are all in the file
+ */
+bool FrameStoreReader::fetch(long long offset, size_t bytes, char *dst)
+{
+    if (offset < 0)
+        return false;
+    if (map) {
+        if (static_cast<size_t>(offset) > mapSize || bytes > mapSize - offset)
+            return false;
+        memcpy(dst, map + offset, bytes);
+        return true;
+    }
+    return file && seekTo(file, offset) && fread(dst, 1, bytes, file) == bytes;
+}
+
+/**
+ * isOpened	-	is a store open
+ *
+ * @return True if open
+ */
+bool FrameStoreReader::isOpened() const
+{
+    return !index.empty();
+}
+
+/**
+ * read	-	read a frame
+ *
+ * @param i	-	index of the frame, 0-based
+ * @param frame	-	the frame, always reallocated
+ *
+ * @return True if success
+ */
+bool FrameStoreReader::read(long i, cv::Mat &frame)
+{
+    if (i < 0 || i >= static_cast<long>(index.size()))
+        return false;
+    const FrameStoreChunk &chunk = index[i];
+    size_t raw = rawBytes(header);
+    if (chunk.size <= 0 || static_cast<size_t>(chunk.size) > raw)
+        return false;
+
+    // a fresh Mat, the last frame may still be shown or queued
+    frame = cv::Mat(header.height, header.width, header.type);
+    char *dst = reinterpret_cast<char *>(frame.data);
+    if (static_cast<size_t>(chunk.size) == raw)
+        return fetch(chunk.offset, raw, dst);
+
+#ifdef EVM_HAVE_LZ4
+    const char *src;
+    if (map) {
+        if (static_cast<size_t>(chunk.offset) > mapSize
+                || static_cast<size_t>(chunk.size) > mapSize - chunk.offset)
+            return false;
+        // decompressed straight from the mapping
+        src = map + chunk.offset;
+    } else {
+        buffer.resize(chunk.size);
+        if (!fetch(chunk.offset, chunk.size, &buffer[0]))
+            return false;
+        src = &buffer[0];
+    }
+    return LZ4_decompress_safe(src, dst, static_cast<int>(chunk.size),
+                               static_cast<int>(raw)) == static_cast<int>(raw);
+#else
+    return false;
+#endif
+}
+
+/**
+ * release	-	close the store
+ *
+ */
+void FrameStoreReader::release()
+{
+#ifdef EVM_HAVE_MMAP
+    if (map)
+        munmap(const_cast<char *>(map), mapSize);
+#endif
+    map = 0;
+    mapSize = 0;
+    if (file)
+        fclose(file);
+    file = 0;
+    index.clear();
+    buffer.clear();
+}
+
+/**
+ * frames	-	number of frames
+ *
+ * @return the frame count
+ */
+long FrameStoreReader::frames() const
+{
+    return static_cast<long>(index.size());
+}
+
+/**
+ * fps	-	frame rate
+ *
+ * @return frames per second
+ */
+double FrameStoreReader::fps() const
+{
+    return header.fps;
+}
+
+/**
+ * size	-	frame size
+ *
+ * @return the size of every frame
+ */
+cv::Size FrameStoreReader::size() const
+{
+    return cv::Size(header.width, header.height);
+}
+
+/**
+ * type	-	type of the frames
+ *
+ * @return the OpenCV type
+ */
+int FrameStoreReader::type() const
+{
+    return header.type;
+}
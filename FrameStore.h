@@ -0,0 +1,154 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef FRAMESTORE_H
+#define FRAMESTORE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * FrameStore	-	lossless container of raw frames
+ *
+ * The temp files between magnifications, which are written once
+ * and read back many times. Frames are stored raw, or LZ4
+ * compressed when built with EVM_HAVE_LZ4, one chunk each, and an
+ * index of the chunks at the end of the file gives any frame in
+ * O(1) without decoding the others.
+ *
+ * Layout: a 64 byte header ("EVMF", version, frame size and type,
+ * fps, frame count, offset of the index), the chunks, then the
+ * index, an offset and a size for every frame.
+ */
+
+// extension of frame store files
+#define FRAME_STORE_EXT ".evmf"
+
+struct FrameStoreHeader {
+    char magic[4];
+    unsigned int version;
+    int width;
+    int height;
+    int type;
+    // the chunks may be LZ4 compressed
+    unsigned int compressed;
+    double fps;
+    long long frames;
+    long long indexOffset;
+    char reserved[16];
+};
+
+struct FrameStoreChunk {
+    long long offset;
+    // a chunk as large as a raw frame is stored raw
+    long long size;
+};
+
+// is the name one of a frame store
+bool isFrameStore(const std::string &fileName);
+
+/**
+ * FrameStoreWriter	-	appends frames to a new store
+ */
+class FrameStoreWriter {
+public:
+    FrameStoreWriter();
+    ~FrameStoreWriter();
+
+    // create the store
+    bool open(const std::string &fileName, cv::Size size, int type,
+              double fps, bool compress = true);
+
+    // is a store open
+    bool isOpened() const;
+
+    // append a frame of the size and type of the store
+    bool write(const cv::Mat &frame);
+
+    // write the index and close the store
+    void release();
+
+    // can chunks be compressed in this build
+    static bool canCompress();
+
+private:
+    FrameStoreWriter(const FrameStoreWriter &);
+    FrameStoreWriter &operator=(const FrameStoreWriter &);
+
+    FILE *file;
+    FrameStoreHeader header;
+    std::vector<FrameStoreChunk> index;
+    std::vector<char> buffer;
+    long long offset;
+};
+
+/**
+ * FrameStoreReader	-	random access to the frames of a store
+ *
+ * The file is memory-mapped where mmap is available, read with
+ * stdio otherwise. Frames are copied out of the mapping, so they
+ * outlive the reader.
+ */
+class FrameStoreReader {
+public:
+    FrameStoreReader();
+    ~FrameStoreReader();
+
+    // open a complete store
+    bool open(const std::string &fileName);
+
+    // is a store open
+    bool isOpened() const;
+
+    // read a frame, 0-based
+    bool read(long index, cv::Mat &frame);
+
+    // close the store
+    void release();
+
+    // number of frames
+    long frames() const;
+
+    // frame rate
+    double fps() const;
+
+    // frame size
+    cv::Size size() const;
+
+    // type of the frames
+    int type() const;
+
+private:
+    FrameStoreReader(const FrameStoreReader &);
+    FrameStoreReader &operator=(const FrameStoreReader &);
+
+    // copy bytes of the file at offset
+    bool fetch(long long offset, size_t bytes, char *dst);
+
+    FILE *file;
+    const char *map;
+    size_t mapSize;
+    FrameStoreHeader header;
+    std::vector<FrameStoreChunk> index;
+    std::vector<char> buffer;
+};
+
+#endif // FRAMESTORE_H
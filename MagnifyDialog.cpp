@@ -19,8 +19,14 @@
 
 #include "MagnifyDialog.h"
 #include <string.h>
+#include <QPixmap>
 #include "ui_MagnifyDialog.h"
 
+// wait for the sliders to settle this long before previewing
+static const int PREVIEW_DEBOUNCE_MS = 250;
+// largest width of the preview frames
+static const int PREVIEW_WIDTH = 320;
+
 MagnifyDialog::MagnifyDialog(QWidget *parent, VideoProcessor *processor) :
     QDialog(parent),
     ui(new Ui::MagnifyDialog)
@@ -51,6 +57,23 @@ MagnifyDialog::MagnifyDialog(QWidget *parent, VideoProcessor *processor) :
     ss.str("");
     ss << chromStr.toStdString() << processor->chromAttenuation;
     ui->chromLabel->setText(QString::fromStdString(ss.str()));
+
+    ui->streamingCheck->setChecked(processor->streaming);
+    ui->butterworthCheck->setChecked(processor->colorFilter == BUTTERWORTH);
+    ui->rieszCheck->setChecked(processor->motionFilter == RIESZ);
+
+    mode = MOTION_MAGNIFY;
+    previewIndex = 0;
+    previewer = new Previewer(this);
+    debounceTimer = new QTimer(this);
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(PREVIEW_DEBOUNCE_MS);
+    playbackTimer = new QTimer(this);
+    connect(debounceTimer, SIGNAL(timeout()), this, SLOT(startPreview()));
+    connect(playbackTimer, SIGNAL(timeout()), this, SLOT(nextPreviewFrame()));
+    connect(previewer, SIGNAL(ready()), this, SLOT(showPreview()));
+    connect(this, SIGNAL(finished(int)), this, SLOT(stopPreview()));
+    ui->previewLabel->hide();
 }
 
 MagnifyDialog::~MagnifyDialog()
@@ -58,12 +81,115 @@ MagnifyDialog::~MagnifyDialog()
     delete ui;
 }
 
+/**
+ * prepare	-	set the mode of the coming run
+ *
+ * The preview starts at the current position of the video.
+ *
+ * @param mode	-	motion or color magnification
+ */
+void MagnifyDialog::prepare(magnifyMode mode)
+{
+    this->mode = mode;
+    ui->previewStartSpin->setValue(processor->getPositionMS() / 1000.0);
+    schedulePreview();
+}
+
+/**
+ * schedulePreview	-	preview once the parameters stop changing
+ *
+ * The preview in flight is of outdated parameters, so it is
+ * cancelled right away.
+ */
+void MagnifyDialog::schedulePreview()
+{
+    if (!ui->previewCheck->isChecked())
+        return;
+    previewer->cancel();
+    debounceTimer->start();
+}
+
+/**
+ * startPreview	-	magnify the preview range in the background
+ *
+ */
+void MagnifyDialog::startPreview()
+{
+    MagnifyJob job;
+    job.input = processor->getSourceFile(mode == COLOR_MAGNIFY);
+    job.mode = mode;
+    job.alpha = processor->alpha;
+    job.lambda_c = processor->lambda_c;
+    job.fl = processor->fl;
+    job.fh = processor->fh;
+    job.chromAttenuation = processor->chromAttenuation;
+    job.levels = processor->levels;
+    job.motionFilter = processor->motionFilter;
+    job.colorFilter = processor->colorFilter;
+    job.filterOrder = processor->filterOrder;
+    // so that the preview matches the final render
+    job.precision = processor->precision;
+    job.streaming = processor->streaming;
+    previewer->start(job, ui->previewStartSpin->value(),
+                     ui->previewLengthSpin->value(), PREVIEW_WIDTH);
+}
+
+/**
+ * stopPreview	-	cancel the preview and clear it
+ *
+ */
+void MagnifyDialog::stopPreview()
+{
+    debounceTimer->stop();
+    playbackTimer->stop();
+    previewer->cancel();
+    previewFrames.clear();
+    ui->previewLabel->clear();
+}
+
+/**
+ * showPreview	-	loop the frames of a finished preview
+ *
+ */
+void MagnifyDialog::showPreview()
+{
+    double rate;
+    std::vector<cv::Mat> frames = previewer->takeFrames(rate);
+    if (frames.empty() || !ui->previewCheck->isChecked())
+        return;
+
+    previewFrames.clear();
+    cv::Mat rgb;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        cv::cvtColor(frames[i], rgb, CV_BGR2RGB);
+        previewFrames.push_back(QImage((const unsigned char*)(rgb.data),
+                                       rgb.cols, rgb.rows, rgb.step,
+                                       QImage::Format_RGB888).copy());
+    }
+    previewIndex = 0;
+    playbackTimer->start(cvRound(1000.0 / std::max(rate, 1.0)));
+    nextPreviewFrame();
+}
+
+/**
+ * nextPreviewFrame	-	show the next preview frame
+ *
+ */
+void MagnifyDialog::nextPreviewFrame()
+{
+    if (previewFrames.empty())
+        return;
+    previewIndex %= previewFrames.size();
+    ui->previewLabel->setPixmap(QPixmap::fromImage(previewFrames[previewIndex++]));
+}
+
 void MagnifyDialog::on_alphaSlider_valueChanged(int value)
 {
     processor->alpha = value;
     std::stringstream ss;
     ss << alphaStr.toStdString() << processor->alpha;
     ui->alphaLabel->setText(QString::fromStdString(ss.str()));
+    schedulePreview();
 }
 
 void MagnifyDialog::on_lambdaSlider_valueChanged(int value)
@@ -72,6 +198,7 @@ void MagnifyDialog::on_lambdaSlider_valueChanged(int value)
     std::stringstream ss;
     ss << lambdaStr.toStdString() << processor->lambda_c;
     ui->lambdaLabel->setText(QString::fromStdString(ss.str()));
+    schedulePreview();
 }
 
 void MagnifyDialog::on_flSlider_valueChanged(int value)
@@ -80,6 +207,7 @@ void MagnifyDialog::on_flSlider_valueChanged(int value)
     std::stringstream ss;
     ss << flStr.toStdString() << processor->fl;
     ui->flLabel->setText(QString::fromStdString(ss.str()));
+    schedulePreview();
 }
 
 void MagnifyDialog::on_fhSlider_valueChanged(int value)
@@ -88,6 +216,7 @@ void MagnifyDialog::on_fhSlider_valueChanged(int value)
     std::stringstream ss;
     ss << fhStr.toStdString() << processor->fh;
     ui->fhLabel->setText(QString::fromStdString(ss.str()));
+    schedulePreview();
 }
 
 void MagnifyDialog::on_chromSlider_valueChanged(int value)
@@ -96,4 +225,42 @@ void MagnifyDialog::on_chromSlider_valueChanged(int value)
     std::stringstream ss;
     ss << chromStr.toStdString() << processor->chromAttenuation;
     ui->chromLabel->setText(QString::fromStdString(ss.str()));
+    schedulePreview();
+}
+
+void MagnifyDialog::on_streamingCheck_toggled(bool checked)
+{
+    processor->setStreaming(checked);
+    schedulePreview();
+}
+
+void MagnifyDialog::on_butterworthCheck_toggled(bool checked)
+{
+    processor->setColorFilter(checked ? BUTTERWORTH : IDEAL);
+    schedulePreview();
+}
+
+void MagnifyDialog::on_rieszCheck_toggled(bool checked)
+{
+    processor->setMotionFilter(checked ? RIESZ : LAPLACIAN);
+    schedulePreview();
+}
+
+void MagnifyDialog::on_previewCheck_toggled(bool checked)
+{
+    ui->previewLabel->setVisible(checked);
+    if (checked)
+        schedulePreview();
+    else
+        stopPreview();
+}
+
+void MagnifyDialog::on_previewStartSpin_valueChanged(double)
+{
+    schedulePreview();
+}
+
+void MagnifyDialog::on_previewLengthSpin_valueChanged(double)
+{
+    schedulePreview();
 }
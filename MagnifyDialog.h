@@ -21,7 +21,11 @@
 #define MAGNIFYDIALOG_H
 
 #include <QDialog>
+#include <QTimer>
+#include <QImage>
+#include <vector>
 #include <VideoProcessor.h>
+#include "Previewer.h"
 
 namespace Ui {
 class MagnifyDialog;
@@ -36,6 +40,9 @@ public:
                          VideoProcessor *processor = 0);
     ~MagnifyDialog();
 
+    // set the mode of the coming run, before exec()
+    void prepare(magnifyMode mode);
+
 private slots:
     void on_alphaSlider_valueChanged(int value);
 
@@ -47,10 +54,48 @@ private slots:
 
     void on_chromSlider_valueChanged(int value);
 
+    void on_streamingCheck_toggled(bool checked);
+
+    void on_butterworthCheck_toggled(bool checked);
+
+    void on_rieszCheck_toggled(bool checked);
+
+    void on_previewCheck_toggled(bool checked);
+
+    void on_previewStartSpin_valueChanged(double value);
+
+    void on_previewLengthSpin_valueChanged(double value);
+
+    // start a preview once the parameters settle
+    void startPreview();
+
+    // cancel the preview and clear it
+    void stopPreview();
+
+    // take the frames of a finished preview
+    void showPreview();
+
+    // show the next preview frame
+    void nextPreviewFrame();
+
 private:
+    // restart the debounce timer of the preview
+    void schedulePreview();
+
     Ui::MagnifyDialog *ui;
     VideoProcessor *processor;
     QString alphaStr, lambdaStr, flStr, fhStr, chromStr;
+
+    // mode of the coming run
+    magnifyMode mode;
+    // background magnification of the preview
+    Previewer *previewer;
+    // fires once the parameters stopped changing
+    QTimer *debounceTimer;
+    // loops the preview
+    QTimer *playbackTimer;
+    std::vector<QImage> previewFrames;
+    size_t previewIndex;
 };
 
 #endif // MAGNIFYDIALOG_H
@@ -0,0 +1,322 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "Precision.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define EVM_HAVE_SSE2 1
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define EVM_HAVE_F16C_DISPATCH 1
+#endif
+
+#if defined(EVM_HAVE_SSE2) || defined(EVM_HAVE_F16C_DISPATCH)
+#include <immintrin.h>
+#endif
+
+// the row conversions between floats and half floats
+typedef void (*HalfPackKernel)(const float *, unsigned short *, int);
+typedef void (*HalfUnpackKernel)(const unsigned short *, float *, int);
+
+/**
+ * floatToHalf	-	round a float to the nearest half float
+ *
+ * Out of range values become infinity, tiny ones subnormal.
+ */
+static unsigned short floatToHalf(float f)
+{
+    union { float f; unsigned u; } v;
+    v.f = f;
+    unsigned sign = (v.u >> 16) & 0x8000;
+    unsigned bits = v.u & 0x7fffffff;
+    // too large, infinity or NaN
+    if (bits >= 0x47800000)
+        return sign | (bits > 0x7f800000 ? 0x7e00 : 0x7c00);
+    // below the smallest normal half, in steps of 2^-24
+    if (bits < 0x38800000) {
+        v.u = bits;
+        return sign | (unsigned short)cvRound(v.f * 16777216.0f);
+    }
+    // re-bias the exponent and round the mantissa to even
+    bits += 0xc8000fff + ((bits >> 13) & 1);
+    return sign | (bits >> 13);
+}
+
+/**
+ * halfToFloat	-	the float value of a half float
+ */
+static float halfToFloat(unsigned short h)
+{
+    union { float f; unsigned u; } v;
+    unsigned sign = (unsigned)(h & 0x8000) << 16;
+    unsigned exponent = (h >> 10) & 0x1f;
+    unsigned mantissa = h & 0x3ff;
+    if (exponent == 0) {
+        v.f = mantissa * (1.0f / 16777216.0f);
+        v.u |= sign;
+    } else if (exponent == 31) {
+        v.u = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        v.u = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    return v.f;
+}
+
+static void packHalfScalar(const float *src, unsigned short *dst, int n)
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = floatToHalf(src[i]);
+}
+
+static void unpackHalfScalar(const unsigned short *src, float *dst, int n)
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = halfToFloat(src[i]);
+}
+
+#ifdef EVM_HAVE_F16C_DISPATCH
+/**
+ * packHalfF16C	-	floats to half floats, 8 at a time
+ *
+ * Compiled for F16C regardless of the build flags,
+ * and only called when the CPU supports it.
+ */
+__attribute__((target("avx,f16c")))
+static void packHalfF16C(const float *src, unsigned short *dst, int n)
+{
+    int i = 0;
+    for (; i <= n - 8; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *)(dst + i), h);
+    }
+    packHalfScalar(src + i, dst + i, n - i);
+}
+
+/**
+ * unpackHalfF16C	-	half floats to floats, 8 at a time
+ */
+__attribute__((target("avx,f16c")))
+static void unpackHalfF16C(const unsigned short *src, float *dst, int n)
+{
+    int i = 0;
+    for (; i <= n - 8; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    unpackHalfScalar(src + i, dst + i, n - i);
+}
+
+static bool haveF16C()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+}
+#endif
+
+/**
+ * selectHalfPack	-	pick the fastest float to half conversion
+ */
+static HalfPackKernel selectHalfPack()
+{
+#ifdef EVM_HAVE_F16C_DISPATCH
+    if (haveF16C())
+        return packHalfF16C;
+#endif
+    return packHalfScalar;
+}
+
+/**
+ * selectHalfUnpack	-	pick the fastest half to float conversion
+ */
+static HalfUnpackKernel selectHalfUnpack()
+{
+#ifdef EVM_HAVE_F16C_DISPATCH
+    if (haveF16C())
+        return unpackHalfF16C;
+#endif
+    return unpackHalfScalar;
+}
+
+/**
+ * packFixed	-	floats to saturated fixed-point values
+ */
+static void packFixed(const float *src, short *dst, int n)
+{
+    int i = 0;
+#ifdef EVM_HAVE_SSE2
+    const __m128 scale = _mm_set1_ps(FIXED_SCALE);
+    for (; i <= n - 8; i += 8) {
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), scale));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = cv::saturate_cast<short>(src[i] * FIXED_SCALE);
+}
+
+/**
+ * unpackFixed	-	fixed-point values to floats
+ */
+static void unpackFixed(const short *src, float *dst, int n)
+{
+    const float unit = 1.0f / FIXED_SCALE;
+    int i = 0;
+#ifdef EVM_HAVE_SSE2
+    const __m128 vunit = _mm_set1_ps(unit);
+    for (; i <= n - 8; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // sign-extend the 16-bit values to 32 bits
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vunit));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vunit));
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = src[i] * unit;
+}
+
+/**
+ * storageType	-	type of a float image stored in a precision
+ *
+ * @param type      -	CV_32F type, any channels
+ * @param precision	-	the precision to store it in
+ *
+ * @return the type of the stored image
+ */
+int storageType(int type, storagePrecision precision)
+{
+    int cn = CV_MAT_CN(type);
+    switch (precision) {
+    case HALF_PRECISION:
+        return CV_MAKETYPE(CV_16U, cn);
+    case FIXED_PRECISION:
+        return CV_MAKETYPE(CV_16S, cn);
+    default:
+        return CV_MAKETYPE(CV_32F, cn);
+    }
+}
+
+/**
+ * storedPrecision	-	precision of a stored image type
+ *
+ * @param type	-	type of the stored image
+ *
+ * @return the precision
+ */
+storagePrecision storedPrecision(int type)
+{
+    switch (CV_MAT_DEPTH(type)) {
+    case CV_16U:
+        return HALF_PRECISION;
+    case CV_16S:
+        return FIXED_PRECISION;
+    default:
+        return FULL_PRECISION;
+    }
+}
+
+/**
+ * packRow	-	store n floats in a precision
+ *
+ * @param src       -	the floats
+ * @param dst       -	n values of the stored type
+ * @param n         -	number of values
+ * @param precision	-	the precision to store them in
+ */
+void packRow(const float *src, void *dst, int n, storagePrecision precision)
+{
+    static const HalfPackKernel packHalf = selectHalfPack();
+
+    switch (precision) {
+    case HALF_PRECISION:
+        packHalf(src, (unsigned short *)dst, n);
+        break;
+    case FIXED_PRECISION:
+        packFixed(src, (short *)dst, n);
+        break;
+    default:
+        std::copy(src, src + n, (float *)dst);
+        break;
+    }
+}
+
+/**
+ * unpackRow	-	convert n stored values back to floats
+ *
+ * @param src       -	n values of the stored type
+ * @param dst       -	the floats
+ * @param n         -	number of values
+ * @param precision	-	the precision they are stored in
+ */
+void unpackRow(const void *src, float *dst, int n, storagePrecision precision)
+{
+    static const HalfUnpackKernel unpackHalf = selectHalfUnpack();
+
+    switch (precision) {
+    case HALF_PRECISION:
+        unpackHalf((const unsigned short *)src, dst, n);
+        break;
+    case FIXED_PRECISION:
+        unpackFixed((const short *)src, dst, n);
+        break;
+    default:
+        std::copy((const float *)src, (const float *)src + n, dst);
+        break;
+    }
+}
+
+/**
+ * packImage	-	store a float image in a precision
+ *
+ * dst is always a copy, it may be a preallocated Mat
+ * (e.g. in a scratch file) of the stored type.
+ *
+ * @param src       -	CV_32F image, any channels
+ * @param dst       -	the stored image
+ * @param precision	-	the precision to store it in
+ */
+void packImage(const cv::Mat &src, cv::Mat &dst, storagePrecision precision)
+{
+    CV_Assert(src.depth() == CV_32F);
+    dst.create(src.size(), storageType(src.type(), precision));
+
+    int n = src.cols * src.channels();
+    for (int y = 0; y < src.rows; ++y)
+        packRow(src.ptr<float>(y), dst.ptr(y), n, precision);
+}
+
+/**
+ * unpackImage	-	convert a stored image back to floats
+ *
+ * @param src	-	image stored by packImage
+ * @param dst	-	CV_32F image
+ */
+void unpackImage(const cv::Mat &src, cv::Mat &dst)
+{
+    storagePrecision precision = storedPrecision(src.type());
+    dst.create(src.size(), CV_MAKETYPE(CV_32F, src.channels()));
+
+    int n = src.cols * src.channels();
+    for (int y = 0; y < src.rows; ++y)
+        unpackRow(src.ptr(y), dst.ptr<float>(y), n, precision);
+}
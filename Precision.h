@@ -0,0 +1,53 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <opencv2/core/core.hpp>
+
+// precision of the stored pyramid levels, filter states and frames:
+// 32-bit floats, IEEE half floats (in CV_16U, as OpenCV 2.4 has no
+// CV_16F) or 16-bit fixed-point (CV_16S) scaled by FIXED_SCALE.
+// The computations always run in 32-bit floats.
+enum storagePrecision {FULL_PRECISION, HALF_PRECISION, FIXED_PRECISION};
+
+// scale of the fixed-point values, covering +-256 in steps of 1/128,
+// which holds both Lab laplacian bands and 0-255 pixel values
+const float FIXED_SCALE = 128.0f;
+
+// type of a CV_32F image stored in the given precision
+int storageType(int type, storagePrecision precision);
+
+// precision of a stored image type
+storagePrecision storedPrecision(int type);
+
+// store a CV_32F image in the given precision (always a new copy)
+void packImage(const cv::Mat &src, cv::Mat &dst, storagePrecision precision);
+
+// convert a stored image back to CV_32F
+void unpackImage(const cv::Mat &src, cv::Mat &dst);
+
+// store n floats in the given precision
+void packRow(const float *src, void *dst, int n, storagePrecision precision);
+
+// convert n stored values back to floats
+void unpackRow(const void *src, float *dst, int n, storagePrecision precision);
+
+#endif // PRECISION_H
@@ -0,0 +1,242 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "Previewer.h"
+#include "VideoProcessor.h"
+#include <stdio.h>
+#include <cmath>
+#include <sstream>
+#include <QDateTime>
+
+Previewer::Previewer(QObject *parent)
+    : QObject(parent)
+    , generation(0)
+    , running(0)
+    , active(0)
+    , rate(0)
+{
+}
+
+Previewer::~Previewer()
+{
+    cancel();
+    // the workers are detached, wait for them to leave run()
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running > 0)
+        finished.wait(lock);
+}
+
+/**
+ * Running	-	counts a worker as running for its lifetime
+ *
+ */
+class Previewer::Running {
+public:
+    explicit Running(Previewer &previewer)
+        : previewer(previewer)
+    {
+    }
+
+    ~Running()
+    {
+        // notify under the lock, so ~Previewer cannot return first
+        std::lock_guard<std::mutex> lock(previewer.mutex);
+        --previewer.running;
+        previewer.finished.notify_all();
+    }
+
+private:
+    Previewer &previewer;
+};
+
+/**
+ * start	-	start a preview, cancelling the one in flight
+ *
+ * @param job	-	input and parameters, the output is unused
+ * @param start	-	first second of the preview
+ * @param length	-	seconds to magnify
+ * @param width	-	largest width of the preview frames
+ */
+void Previewer::start(const MagnifyJob &job, double start, double length, int width)
+{
+    cancel();
+    // the cancelled preview winds down on its own thread, rather
+    // than blocking the caller until it notices
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++running;
+    }
+    std::thread(&Previewer::run, this, job, start, length, width,
+                (int)generation).detach();
+}
+
+/**
+ * cancel	-	cancel the preview in flight
+ *
+ */
+void Previewer::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ++generation;
+    if (active)
+        active->cancelIt();
+}
+
+/**
+ * takeFrames	-	the frames of the last finished preview
+ *
+ * @param rate	-	destinate frame rate of the preview
+ *
+ * @return the frames, empty if they have already been taken
+ */
+std::vector<cv::Mat> Previewer::takeFrames(double &rate)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<cv::Mat> taken;
+    taken.swap(frames);
+    rate = this->rate;
+    return taken;
+}
+
+/**
+ * isCurrent	-	is a preview still the latest one
+ *
+ * @param id	-	id of the preview
+ *
+ * @return false if it has been cancelled
+ */
+bool Previewer::isCurrent(int id)
+{
+    return generation.load() == id;
+}
+
+/**
+ * run	-	magnify one preview
+ *
+ * The frames are downscaled into a small frame store, which a
+ * VideoProcessor of its own magnifies like a full run.
+ *
+ * @param job	-	input and parameters
+ * @param start	-	first second
+ * @param length	-	seconds to magnify
+ * @param width	-	largest width of the frames
+ * @param id	-	id of the preview
+ */
+void Previewer::run(MagnifyJob job, double start, double length, int width, int id)
+{
+    Running running(*this);
+
+    FrameSource capture(job.input);
+    if (!capture.isOpened())
+        return;
+    double fps = capture.get(CV_CAP_PROP_FPS);
+    if (fps <= 0)
+        fps = 25;
+    capture.set(CV_CAP_PROP_POS_FRAMES, std::max(start, 0.0) * fps);
+
+    std::stringstream ss;
+    ss << "temp_preview_" << QDateTime::currentMSecsSinceEpoch() << "_" << id << FRAME_STORE_EXT;
+    std::string clip = ss.str();
+
+    // 1. the downscaled range
+    FrameSink writer;
+    cv::Mat frame, small;
+    double scale = 1;
+    int count = std::max(cvRound(length * fps), 2);
+    for (int i = 0; i < count && isCurrent(id); ++i) {
+        if (!capture.read(frame))
+            break;
+        scale = std::min(1.0, (double)width / frame.cols);
+        cv::resize(frame, small, cv::Size(), scale, scale, cv::INTER_AREA);
+        if (!writer.isOpened()
+                && !writer.open(clip, CV_FOURCC('M', 'J', 'P', 'G'), fps, small.size(), true))
+            return;
+        writer.write(small);
+    }
+    capture.release();
+    writer.release();
+
+    // 2. magnify it, with the cut-off wavelength and the pyramid
+    // shrunk like the frames, so that the same bands are amplified
+    job.lambda_c *= scale;
+    job.levels = std::max(job.levels - cvRound(std::log(1 / scale) / std::log(2.0)), 1);
+    std::vector<cv::Mat> magnified;
+    if (isCurrent(id)) {
+        VideoProcessor processor;
+        if (processor.setInput(clip)) {
+            processor.setAlpha(job.alpha);
+            processor.setLambdaC(job.lambda_c);
+            processor.setCutoffs(job.fl, job.fh);
+            processor.setChromAttenuation(job.chromAttenuation);
+            processor.setLevels(job.levels);
+            processor.setMotionFilter(job.motionFilter);
+            processor.setColorFilter(job.colorFilter);
+            processor.setFilterOrder(job.filterOrder);
+            processor.setPrecision(job.precision);
+            processor.setStreaming(job.streaming);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // cancelled before it could be stopped
+                if (isCurrent(id)) {
+                    processor.clearCancel();
+                    active = &processor;
+                } else {
+                    processor.cancelIt();
+                }
+            }
+            if (isCurrent(id)) {
+                if (job.mode == COLOR_MAGNIFY)
+                    processor.colorMagnify();
+                else
+                    processor.motionMagnify();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // a newer preview may own it by now
+                if (active == &processor)
+                    active = 0;
+            }
+
+            // 3. read the result back
+            std::string result;
+            processor.getCurTempFile(result);
+            if (isCurrent(id) && result != clip) {
+                FrameSource output(result);
+                while (isCurrent(id) && output.read(frame))
+                    magnified.push_back(frame.clone());
+            }
+
+            std::string temp;
+            while (true) {
+                processor.getTempFile(temp);
+                if (temp.empty())
+                    break;
+                remove(temp.c_str());
+            }
+        }
+    }
+    remove(clip.c_str());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isCurrent(id) || magnified.empty())
+        return;
+    frames.swap(magnified);
+    rate = fps;
+    emit ready();
+}
@@ -0,0 +1,85 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef PREVIEWER_H
+#define PREVIEWER_H
+
+#include <QObject>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "BatchEngine.h"
+
+class VideoProcessor;
+
+/**
+ * Previewer	-	magnifies a short, downscaled part of a video
+ *                  in the background
+ *
+ * A new preview cancels the one in flight, which winds down on its
+ * own thread. ready() is emitted in the thread of the previewer once
+ * the frames of the latest preview can be taken.
+ */
+class Previewer : public QObject {
+
+    Q_OBJECT
+
+public:
+    explicit Previewer(QObject *parent = 0);
+    ~Previewer();
+
+    // magnify length seconds from start, frames at most width pixels wide
+    void start(const MagnifyJob &job, double start, double length, int width);
+
+    // cancel the preview in flight, if any
+    void cancel();
+
+    // the frames of the last finished preview, and its frame rate
+    std::vector<cv::Mat> takeFrames(double &rate);
+
+signals:
+    void ready();
+
+private:
+    // magnify one preview on the worker thread
+    void run(MagnifyJob job, double start, double length, int width, int id);
+
+    // is a preview still the latest one
+    bool isCurrent(int id);
+
+    class Running;
+
+    // id of the latest preview
+    std::atomic<int> generation;
+    // guards active, running and the results
+    std::mutex mutex;
+    // worker threads not yet finished
+    int running;
+    // signalled when a worker finishes
+    std::condition_variable finished;
+    // processor of the preview in flight
+    VideoProcessor *active;
+    std::vector<cv::Mat> frames;
+    double rate;
+};
+
+#endif // PREVIEWER_H
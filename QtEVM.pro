@@ -11,18 +11,49 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = excutable
 TEMPLATE = app
 
+CONFIG += c++11 thread
+
 SOURCES += main.cpp\
         mainwindow.cpp \
-    WindowHelper.cpp \
     VideoProcessor.cpp \
     SpatialFilter.cpp \
+    TemporalFilter.cpp \
+    Precision.cpp \
+    RieszMagnifier.cpp \
+    TemporalFFT.cpp \
+    TimeSeries.cpp \
+    ScratchFile.cpp \
+    StageProfiler.cpp \
+    BandCache.cpp \
+    FrameCache.cpp \
+    FrameStore.cpp \
+    FrameSource.cpp \
+    VideoProbe.cpp \
+    BatchEngine.cpp \
+    Previewer.cpp \
+    FrameDisplay.cpp \
     MagnifyDialog.cpp
 
 HEADERS  += mainwindow.h \
-    WindowHelper.h \
     VideoProcessor.h \
     SpatialFilter.h \
-    MagnifyDialog.h
+    TemporalFilter.h \
+    Precision.h \
+    RieszMagnifier.h \
+    TemporalFFT.h \
+    TimeSeries.h \
+    ScratchFile.h \
+    StageProfiler.h \
+    BandCache.h \
+    FrameCache.h \
+    FrameStore.h \
+    FrameSource.h \
+    VideoProbe.h \
+    BatchEngine.h \
+    Previewer.h \
+    FrameDisplay.h \
+    MagnifyDialog.h \
+    FrameQueue.h
 
 FORMS    += mainwindow.ui \
     MagnifyDialog.ui
@@ -30,16 +61,4 @@ FORMS    += mainwindow.ui \
 RESOURCES += \
     myResources.qrc
 
-unix {
-    CONFIG += link_pkgconfig
-    PKGCONFIG += opencv
-}
-Win32 {
-INCLUDEPATH += C:\OpenCV2.2\include\
-LIBS += -LC:\OpenCV2.2\lib \
-    -lopencv_core220 \
-    -lopencv_highgui220 \
-    -lopencv_imgproc220 \
-    -lopencv_features2d220 \
-    -lopencv_calib3d220
-}
+include(opencv.pri)
@@ -0,0 +1,250 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "RieszMagnifier.h"
+#include "TemporalFilter.h"
+#include <math.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+// keeps the divisions by a vanishing amplitude finite
+static const float AMPLITUDE_EPSILON = 1e-6f;
+
+/**
+ * PhaseFilter	-	phase difference, accumulation and temporal
+ *                  filtering of row strips of a level
+ */
+class RieszMagnifier::PhaseFilter : public cv::ParallelLoopBody {
+public:
+    PhaseFilter(const cv::Mat &level, Level &state, float fl, float fh)
+        : level(level)
+        , state(state)
+        , fl(fl)
+        , fh(fh)
+    {
+    }
+
+    void operator()(const cv::Range &range) const
+    {
+        for (int r = range.start; r < range.end; ++r) {
+            const float *real = level.ptr<float>(r);
+            const float *x = state.rx.ptr<float>(r);
+            const float *y = state.ry.ptr<float>(r);
+            float *prevReal = state.real.ptr<float>(r);
+            float *prevX = state.x.ptr<float>(r);
+            float *prevY = state.y.ptr<float>(r);
+            float *phase = state.phase.ptr<float>(r);
+            float *amplitude = state.amplitude.ptr<float>(r);
+            for (int i = 0; i < level.cols; ++i) {
+                // q = current * conj(previous)
+                float qr = real[i] * prevReal[i] + x[i] * prevX[i] + y[i] * prevY[i];
+                float qx = prevReal[i] * x[i] - real[i] * prevX[i];
+                float qy = prevReal[i] * y[i] - real[i] * prevY[i];
+                float qxy = sqrtf(qx * qx + qy * qy);
+                // the phase difference along the local orientation
+                float difference = atan2f(qxy, qr);
+                if (qxy > AMPLITUDE_EPSILON) {
+                    phase[2*i] += difference * qx / qxy;
+                    phase[2*i+1] += difference * qy / qxy;
+                }
+                amplitude[i] = sqrtf(sqrtf(qr * qr + qxy * qxy));
+                prevReal[i] = real[i];
+                prevX[i] = x[i];
+                prevY[i] = y[i];
+            }
+        }
+
+        // bandpass the phase of the strip
+        cv::Mat band = state.band.rowRange(range.start, range.end);
+        cv::Mat lowpassHi = state.lowpassHi.rowRange(range.start, range.end);
+        cv::Mat lowpassLo = state.lowpassLo.rowRange(range.start, range.end);
+        iirBandpass(state.phase.rowRange(range.start, range.end),
+                    lowpassHi, lowpassLo, band, fl, fh);
+
+        // weight it by the amplitude, for the blur
+        for (int r = range.start; r < range.end; ++r) {
+            float *b = state.band.ptr<float>(r);
+            const float *amplitude = state.amplitude.ptr<float>(r);
+            for (int i = 0; i < level.cols; ++i) {
+                b[2*i] *= amplitude[i];
+                b[2*i+1] *= amplitude[i];
+            }
+        }
+    }
+
+private:
+    const cv::Mat &level;
+    Level &state;
+    float fl, fh;
+};
+
+/**
+ * PhaseShift	-	shift the phase of row strips of a level
+ *                  by the amplified phase band
+ */
+class RieszMagnifier::PhaseShift : public cv::ParallelLoopBody {
+public:
+    PhaseShift(cv::Mat &level, const Level &state, float alpha)
+        : level(level)
+        , state(state)
+        , alpha(alpha)
+    {
+    }
+
+    void operator()(const cv::Range &range) const
+    {
+        for (int r = range.start; r < range.end; ++r) {
+            float *real = level.ptr<float>(r);
+            const float *x = state.rx.ptr<float>(r);
+            const float *y = state.ry.ptr<float>(r);
+            const float *band = state.band.ptr<float>(r);
+            const float *amplitude = state.amplitude.ptr<float>(r);
+            for (int i = 0; i < level.cols; ++i) {
+                float gain = alpha / (amplitude[i] + AMPLITUDE_EPSILON);
+                float pc = band[2*i] * gain;
+                float ps = band[2*i+1] * gain;
+                float magnitude = sqrtf(pc * pc + ps * ps);
+                if (magnitude <= AMPLITUDE_EPSILON)
+                    continue;
+                // real part of exp(phase) * (real, x, y)
+                float s = sinf(magnitude) / magnitude;
+                real[i] = cosf(magnitude) * real[i] - s * (pc * x[i] + ps * y[i]);
+            }
+        }
+    }
+
+private:
+    cv::Mat &level;
+    const Level &state;
+    float alpha;
+};
+
+RieszMagnifier::RieszMagnifier()
+    : levels(4)
+    , fl(0.05f)
+    , fh(0.4f)
+    , alpha(10)
+    , sigma(2)
+{
+}
+
+/**
+ * setLevels	-	set the levels of the pyramid
+ *
+ * @param levels	-	number of bands, the residual is not magnified
+ */
+void RieszMagnifier::setLevels(int levels)
+{
+    this->levels = std::max(levels, 1);
+    reset();
+}
+
+/**
+ * setCutoffs	-	set the cut-offs of the IIR filter of the phase
+ *
+ * @param fl	-	low cut-off
+ * @param fh	-	high cut-off
+ */
+void RieszMagnifier::setCutoffs(float fl, float fh)
+{
+    this->fl = fl;
+    this->fh = fh;
+}
+
+/**
+ * setAlpha	-	set the amplification of the phase
+ *
+ * A motion d becomes (1 + alpha) * d, as in the linear method.
+ *
+ * @param alpha	-	amplification factor
+ */
+void RieszMagnifier::setAlpha(float alpha)
+{
+    this->alpha = alpha;
+}
+
+/**
+ * setSigma	-	set the sigma of the amplitude weighted blur
+ *
+ * @param sigma	-	sigma in pixels of each level, 0 for no blur
+ */
+void RieszMagnifier::setSigma(double sigma)
+{
+    this->sigma = std::max(sigma, 0.0);
+}
+
+/**
+ * reset	-	forget the previous frames
+ *
+ * The next frame is taken as the reference of the phase.
+ */
+void RieszMagnifier::reset()
+{
+    state.clear();
+}
+
+/**
+ * magnify	-	magnify the motion of a luminance frame
+ *
+ * The first frame after a reset is only recorded.
+ *
+ * @param src	-	luminance (CV_32FC1)
+ * @param dst	-	magnified luminance
+ */
+void RieszMagnifier::magnify(const cv::Mat &src, cv::Mat &dst)
+{
+    CV_Assert(src.type() == CV_32FC1);
+    buildLaplacianPyramid(src, levels, pyramid, workspace);
+
+    bool first = state.size() != (size_t)levels
+            || state[0].real.size() != pyramid.at(0).size();
+    if (first)
+        state.assign(levels, Level());
+
+    for (int l = 0; l < levels; ++l) {
+        Level &level = state[l];
+        cv::Mat &coefficients = pyramid.at(l);
+        rieszTransform(coefficients, level.rx, level.ry);
+
+        if (first) {
+            coefficients.copyTo(level.real);
+            level.rx.copyTo(level.x);
+            level.ry.copyTo(level.y);
+            level.phase = cv::Mat::zeros(coefficients.size(), CV_32FC2);
+            level.lowpassHi = level.phase.clone();
+            level.lowpassLo = level.phase.clone();
+            level.band.create(coefficients.size(), CV_32FC2);
+            level.amplitude.create(coefficients.size(), CV_32FC1);
+            continue;
+        }
+
+        cv::Range rows(0, coefficients.rows);
+        cv::parallel_for_(rows, PhaseFilter(coefficients, level, fl, fh));
+
+        // the phase is noisy where the amplitude is low,
+        // so it is smoothed weighted by the amplitude
+        if (sigma > 0) {
+            cv::GaussianBlur(level.band, level.band, cv::Size(), sigma);
+            cv::GaussianBlur(level.amplitude, level.amplitude, cv::Size(), sigma);
+        }
+
+        cv::parallel_for_(rows, PhaseShift(coefficients, level, alpha));
+    }
+
+    reconImgFromLaplacianPyramid(pyramid, levels, dst, workspace);
+}
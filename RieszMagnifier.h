@@ -0,0 +1,87 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef RIESZMAGNIFIER_H
+#define RIESZMAGNIFIER_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "SpatialFilter.h"
+
+/**
+ * RieszMagnifier	-	phase-based motion magnification with a Riesz pyramid
+ *
+ * Each laplacian level and its Riesz transform give the local amplitude,
+ * phase and orientation of the luminance. The frame to frame change of
+ * the quaternionic phase is accumulated, bandpassed by the IIR filter of
+ * motion magnification, smoothed weighted by the amplitude, amplified
+ * and applied as a phase shift. Shifting the phase moves the structures
+ * instead of adding to their intensity, so large amplifications don't
+ * amplify the noise the way the linear method does.
+ */
+class RieszMagnifier {
+public:
+    RieszMagnifier();
+
+    // set the levels of the pyramid
+    void setLevels(int levels);
+
+    // set the cut-offs of the IIR filter, as in motion magnification
+    void setCutoffs(float fl, float fh);
+
+    // set the amplification of the phase
+    void setAlpha(float alpha);
+
+    // set the sigma of the amplitude weighted blur of the phase
+    void setSigma(double sigma);
+
+    // forget the previous frames
+    void reset();
+
+    // magnify the motion of a luminance frame, dst may be src
+    void magnify(const cv::Mat &src, cv::Mat &dst);
+
+private:
+    // state of a pyramid level
+    struct Level {
+        // Riesz pyramid coefficients of the previous frame
+        cv::Mat real, x, y;
+        // accumulated quaternionic phase, (phase cos, phase sin)
+        cv::Mat phase;
+        // IIR states of the phase
+        cv::Mat lowpassHi, lowpassLo;
+        // Riesz transform of the current frame
+        cv::Mat rx, ry;
+        // amplitude weighted bandpassed phase, and the amplitude
+        cv::Mat band, amplitude;
+    };
+
+    int levels;
+    float fl, fh;
+    float alpha;
+    double sigma;
+    std::vector<Level> state;
+    std::vector<cv::Mat> pyramid;
+    PyramidWorkspace workspace;
+
+    class PhaseFilter;
+    class PhaseShift;
+};
+
+#endif // RIESZMAGNIFIER_H
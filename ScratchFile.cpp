@@ -0,0 +1,176 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "ScratchFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define EVM_HAVE_MMAP 1
+#endif
+
+ScratchFile::ScratchFile()
+    : ptr(0)
+    , bytes(0)
+{
+}
+
+ScratchFile::~ScratchFile()
+{
+    close();
+}
+
+/**
+ * open	-	create and map a scratch file
+ *
+ * @param size	-	size in bytes
+ * @param dir	-	directory of the file
+ *
+ * @return True if success. False otherwise, e.g. on
+ *         platforms without mmap
+ */
+bool ScratchFile::open(size_t size, const std::string &dir)
+{
+    close();
+#ifdef EVM_HAVE_MMAP
+    std::string path = dir + "/evm_scratch_XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int fd = mkstemp(&name[0]);
+    if (fd < 0) {
+        perror("Can't create scratch file");
+        return false;
+    }
+    // the name is not needed once the file is open
+    unlink(&name[0]);
+
+#ifdef __APPLE__
+    // no posix_fallocate, the file stays sparse
+    int err = ftruncate(fd, size) != 0 ? errno : 0;
+#else
+    int err = posix_fallocate(fd, 0, size);
+#endif
+    if (err != 0) {
+        errno = err;
+        perror("Can't allocate scratch file");
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping keeps the file alive
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        perror("Can't map scratch file");
+        return false;
+    }
+
+    ptr = static_cast<unsigned char *>(p);
+    bytes = size;
+    return true;
+#else
+    (void)size;
+    (void)dir;
+    return false;
+#endif
+}
+
+/**
+ * close	-	unmap the file, which deletes it
+ *
+ */
+void ScratchFile::close()
+{
+#ifdef EVM_HAVE_MMAP
+    if (ptr)
+        munmap(ptr, bytes);
+#endif
+    ptr = 0;
+    bytes = 0;
+}
+
+/**
+ * isOpened	-	is a file mapped
+ *
+ * @return True if mapped
+ */
+bool ScratchFile::isOpened() const
+{
+    return ptr != 0;
+}
+
+/**
+ * data	-	start of the mapping
+ *
+ * @return the pointer to the first byte
+ */
+unsigned char *ScratchFile::data() const
+{
+    return ptr;
+}
+
+/**
+ * size	-	size of the mapping
+ *
+ * @return the size in bytes
+ */
+size_t ScratchFile::size() const
+{
+    return bytes;
+}
+
+/**
+ * mat	-	a Mat header over part of the mapping
+ *
+ * The Mat does not own the memory, the file must outlive it.
+ *
+ * @param offset	-	offset of the first element in bytes
+ * @param rows		-	number of rows
+ * @param cols		-	number of cols
+ * @param type		-	element type
+ *
+ * @return the Mat, empty if it doesn't fit into the mapping
+ */
+cv::Mat ScratchFile::mat(size_t offset, int rows, int cols, int type) const
+{
+    size_t need = size_t(rows) * cols * CV_ELEM_SIZE(type);
+    if (!ptr || offset + need > bytes)
+        return cv::Mat();
+    return cv::Mat(rows, cols, type, ptr + offset);
+}
+
+/**
+ * physicalMemory	-	physical memory of the machine
+ *
+ * @return the size in bytes, 0 if unknown
+ */
+size_t ScratchFile::physicalMemory()
+{
+#if defined(EVM_HAVE_MMAP) && defined(_SC_PHYS_PAGES)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0)
+        return size_t(pages) * size_t(pageSize);
+#endif
+    return 0;
+}
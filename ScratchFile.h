@@ -0,0 +1,77 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef SCRATCHFILE_H
+#define SCRATCHFILE_H
+
+#include <string>
+#include <cstddef>
+#include <opencv2/core/core.hpp>
+
+/**
+ * ScratchFile	-	a memory-mapped temporary file
+ *
+ * Backs large buffers which would not fit in RAM. The file is
+ * unlinked as soon as it is mapped, so it disappears with the
+ * mapping even if the process dies. The blocks of the file are
+ * allocated up front, so that a full disk fails open() instead of
+ * a write through the mapping.
+ *
+ * No madvise() hints are given, on purpose. POSIX_MADV_SEQUENTIAL
+ * would be wrong, as the frames are written in order but read back
+ * with strides by the transposes, and sequential read-ahead drops
+ * pages behind the reader. MADV_HUGEPAGE only takes effect on
+ * anonymous and tmpfs memory, not on a shared mapping of a file on
+ * disk, so the mapping is neither aligned nor rounded to 2MB pages.
+ */
+class ScratchFile {
+public:
+    ScratchFile();
+    ~ScratchFile();
+
+    // create and map a scratch file of at least bytes in dir
+    bool open(size_t bytes, const std::string &dir = ".");
+
+    // unmap the file
+    void close();
+
+    // is a file mapped
+    bool isOpened() const;
+
+    // start of the mapping
+    unsigned char *data() const;
+
+    // size of the mapping
+    size_t size() const;
+
+    // a Mat header over part of the mapping
+    cv::Mat mat(size_t offset, int rows, int cols, int type) const;
+
+    // physical memory of the machine, 0 if unknown
+    static size_t physicalMemory();
+
+private:
+    ScratchFile(const ScratchFile &);
+    ScratchFile &operator=(const ScratchFile &);
+
+    unsigned char *ptr;
+    size_t bytes;
+};
+
+#endif // SCRATCHFILE_H
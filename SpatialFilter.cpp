@@ -19,6 +19,20 @@
 
 #include "SpatialFilter.h"
 
+/**
+ * detachShared	-	let go of a buffer that other headers still see
+ *
+ * A destination written in place would otherwise show through
+ * shallow copies the caller kept, or through the source itself.
+ *
+ * @param m	-	destination about to be overwritten
+ */
+static void detachShared(cv::Mat &m)
+{
+    if (m.refcount && *m.refcount > 1)
+        m.release();
+}
+
 /** 
  * buildLaplacianPyramid	-	construct a laplacian pyramid from given image
  *
@@ -30,28 +44,58 @@
  */
 bool buildLaplacianPyramid(const cv::Mat &img, const int levels,
                            std::vector<cv::Mat> &pyramid)
+{
+    PyramidWorkspace workspace;
+    pyramid.clear();
+    return buildLaplacianPyramid(img, levels, pyramid, workspace);
+}
+
+/**
+ * buildLaplacianPyramid	-	construct a laplacian pyramid from given image
+ *                              into the buffers of a workspace
+ *
+ * The levels already in pyramid are overwritten in place and the
+ * coarsest level shares its buffer with the workspace, so they are
+ * only valid until the next call with the same workspace.
+ *
+ * @param img		-	source image
+ * @param levels	-	levels of the destinate pyramids
+ * @param pyramid	-	destinate image
+ * @param workspace	-	buffers kept across calls
+ *
+ * @return true if success
+ */
+bool buildLaplacianPyramid(const cv::Mat &img, const int levels,
+                           std::vector<cv::Mat> &pyramid,
+                           PyramidWorkspace &workspace)
 {
     if (levels < 1){
         perror("Levels should be larger than 1");
         return false;
     }
-    pyramid.clear();
-    cv::Mat currentImg = img;
+    pyramid.resize(levels+1);
+    workspace.down.resize(levels);
+    workspace.up.resize(levels);
+    const cv::Mat *currentImg = &img;
     for (int l=0; l<levels; l++) {
-        cv::Mat down,up;
-        pyrDown(currentImg, down);
-        pyrUp(down, up, currentImg.size());
-        cv::Mat lap = currentImg - up;
-        pyramid.push_back(lap);
-        currentImg = down;
+        cv::Mat &down = workspace.down[l];
+        cv::Mat &up = workspace.up[l];
+        cv::pyrDown(*currentImg, down);
+        cv::pyrUp(down, up, currentImg->size());
+        cv::subtract(*currentImg, up, pyramid[l]);
+        currentImg = &down;
     }
-    pyramid.push_back(currentImg);
+    pyramid[levels] = *currentImg;
     return true;
 }
 
 /** 
  * buildGaussianPyramid	-	construct a gaussian pyramid from a given image
  *
+ * The levels already in pyramid are overwritten in place, unless
+ * their buffers are shared with other headers or with img, which
+ * may then be one of the levels.
+ *
  * @param img		-	source image
  * @param levels	-	levels of the destinate pyramids
  * @param pyramid	-	destinate image
@@ -66,13 +110,14 @@ bool buildGaussianPyramid(const cv::Mat &img,
         perror("Levels should be larger than 1");
         return false;
     }
-    pyramid.clear();
-    cv::Mat currentImg = img;
+    // a header of its own, in case img is a level of pyramid
+    cv::Mat source = img;
+    pyramid.resize(levels);
+    const cv::Mat *currentImg = &source;
     for (int l=0; l<levels; l++) {
-        cv::Mat down;
-        cv::pyrDown(currentImg, down);        
-        pyramid.push_back(down);
-        currentImg = down;
+        detachShared(pyramid[l]);
+        cv::pyrDown(*currentImg, pyramid[l]);
+        currentImg = &pyramid[l];
     }
     return true;
 }
@@ -88,13 +133,39 @@ void reconImgFromLaplacianPyramid(const std::vector<cv::Mat> &pyramid,
                                   const int levels,
                                   cv::Mat &dst)
 {
-    cv::Mat currentImg = pyramid[levels];
+    PyramidWorkspace workspace;
+    dst.release();
+    reconImgFromLaplacianPyramid(pyramid, levels, dst, workspace);
+}
+
+/**
+ * reconImgFromLaplacianPyramid	-	reconstruct image from given laplacian pyramid
+ *                                      using the buffers of a workspace
+ *
+ * dst is written in place when it already has the right size and type.
+ *
+ * @param pyramid	-	source laplacian pyramid
+ * @param levels	-	levels of the pyramid
+ * @param dst		-	destinate image
+ * @param workspace	-	buffers kept across calls
+ */
+void reconImgFromLaplacianPyramid(const std::vector<cv::Mat> &pyramid,
+                                  const int levels,
+                                  cv::Mat &dst,
+                                  PyramidWorkspace &workspace)
+{
+    workspace.up.resize(levels);
+    workspace.recon.resize(levels);
+    const cv::Mat *currentImg = &pyramid[levels];
     for (int l=levels-1; l>=0; l--) {
-        cv::Mat up;
-        cv::pyrUp(currentImg, up, pyramid[l].size());
-        currentImg = up + pyramid[l];
+        cv::Mat &up = workspace.up[l];
+        cv::Mat &sum = l > 0 ? workspace.recon[l] : dst;
+        cv::pyrUp(*currentImg, up, pyramid[l].size());
+        cv::add(up, pyramid[l], sum);
+        currentImg = &sum;
     }
-    dst = currentImg.clone();
+    if (levels == 0)
+        pyramid[0].copyTo(dst);
 }
 
 /** 
@@ -108,11 +179,114 @@ void upsamplingFromGaussianPyramid(const cv::Mat &src,
                                    const int levels,
                                    cv::Mat &dst)
 {
-    cv::Mat currentLevel = src.clone();
+    PyramidWorkspace workspace;
+    upsamplingFromGaussianPyramid(src, levels, dst, workspace);
+}
+
+/**
+ * upsamplingFromGaussianPyramid	-	up-sampling an image from gaussian pyramid
+ *                                      using the buffers of a workspace
+ *
+ * dst is written in place when it already has the right size and type
+ * and its buffer is not shared with other headers or with src.
+ *
+ * @param src		-	source image
+ * @param levels	-	levels of the pyramid
+ * @param dst		-	destinate image
+ * @param workspace	-	buffers kept across calls
+ */
+void upsamplingFromGaussianPyramid(const cv::Mat &src,
+                                   const int levels,
+                                   cv::Mat &dst,
+                                   PyramidWorkspace &workspace)
+{
+    if (levels <= 0) {
+        src.copyTo(dst);
+        return;
+    }
+    // a header of its own, in case src is dst
+    cv::Mat source = src;
+    detachShared(dst);
+    workspace.up.resize(levels);
+    const cv::Mat *currentLevel = &source;
     for (int i = 0; i < levels; ++i) {
-        cv::Mat up;
-        cv::pyrUp(currentLevel, up);
-        currentLevel = up;
+        cv::Mat &up = i < levels-1 ? workspace.up[i] : dst;
+        cv::pyrUp(*currentLevel, up);
+        currentLevel = &up;
+    }
+}
+
+/**
+ * rieszTransform	-	approximate Riesz transform of a laplacian level
+ *
+ * The two components are the [0.5, 0, -0.5] differences along x and
+ * along y, which is close to the Riesz transform in the band of a
+ * laplacian level (Wadhwa et al., Riesz Pyramids for Fast Phase-Based
+ * Video Magnification, 2014).
+ *
+ * @param src	-	laplacian level (CV_32FC1)
+ * @param rx	-	horizontal component
+ * @param ry	-	vertical component
+ */
+void rieszTransform(const cv::Mat &src, cv::Mat &rx, cv::Mat &ry)
+{
+    CV_Assert(src.type() == CV_32FC1);
+    rx.create(src.size(), CV_32FC1);
+    ry.create(src.size(), CV_32FC1);
+
+    // borders are reflected without repeating the edge
+    int rows = src.rows, cols = src.cols;
+    for (int y = 0; y < rows; ++y) {
+        const float *row = src.ptr<float>(y);
+        const float *above = src.ptr<float>(y > 0 ? y - 1 : std::min(1, rows - 1));
+        const float *below = src.ptr<float>(y < rows - 1 ? y + 1 : std::max(rows - 2, 0));
+        float *px = rx.ptr<float>(y);
+        float *py = ry.ptr<float>(y);
+        for (int x = 0; x < cols; ++x) {
+            int left = x > 0 ? x - 1 : std::min(1, cols - 1);
+            int right = x < cols - 1 ? x + 1 : std::max(cols - 2, 0);
+            px[x] = 0.5f * (row[left] - row[right]);
+            py[x] = 0.5f * (above[x] - below[x]);
+        }
+    }
+}
+
+/**
+ * splitPyramidTiles	-	split a frame into tiles for separate pyramids
+ *
+ * Each tile is grown by a halo of 4 << levels pixels, which covers
+ * the support of a laplacian pyramid of that depth built and then
+ * collapsed again. Tiles start on multiples of 2^levels, so that
+ * their levels sample the same pixels as the levels of the whole
+ * frame. Hence the cores of the tiles get the same result as the
+ * whole frame, up to float rounding.
+ *
+ * @param frameSize	-	size of the frame
+ * @param levels	-	levels of the pyramids
+ * @param tileSize	-	width and height of the cores, rounded
+ *                      up to a multiple of 2^levels
+ * @param tiles     -	destinate tiles, covering the frame
+ */
+void splitPyramidTiles(const cv::Size &frameSize, const int levels, int tileSize,
+                       std::vector<PyramidTile> &tiles)
+{
+    int step = 1 << levels;
+    int halo = 4 << levels;
+    tileSize = (std::max(tileSize, step) + step - 1) / step * step;
+
+    tiles.clear();
+    for (int y = 0; y < frameSize.height; y += tileSize) {
+        for (int x = 0; x < frameSize.width; x += tileSize) {
+            PyramidTile tile;
+            tile.core = cv::Rect(x, y,
+                                 std::min(tileSize, frameSize.width - x),
+                                 std::min(tileSize, frameSize.height - y));
+            int x0 = std::max(0, x - halo);
+            int y0 = std::max(0, y - halo);
+            int x1 = std::min(frameSize.width, tile.core.br().x + halo);
+            int y1 = std::min(frameSize.height, tile.core.br().y + halo);
+            tile.area = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+            tiles.push_back(tile);
+        }
     }
-    currentLevel.copyTo(dst);
 }
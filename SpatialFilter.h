@@ -23,8 +23,37 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <stdio.h>
+#include <vector>
+#include <algorithm>
 
-// build a gaussian pyramid
+// level buffers kept across frames, so that building and
+// reconstructing pyramids of same-sized frames allocates nothing
+// once the first frame has been processed
+struct PyramidWorkspace {
+    // down-sampled images, one per level
+    std::vector<cv::Mat> down;
+    // up-sampled images, one per level
+    std::vector<cv::Mat> up;
+    // partial reconstructions, one per level
+    std::vector<cv::Mat> recon;
+};
+
+// a tile of a frame that gets its own pyramid
+struct PyramidTile {
+    // the tile and its halo, in frame coordinates
+    cv::Rect area;
+    // the part of the tile that is kept, in frame coordinates
+    cv::Rect core;
+};
+
+// approximate Riesz transform of a laplacian level
+void rieszTransform(const cv::Mat &src, cv::Mat &rx, cv::Mat &ry);
+
+// split a frame into tiles whose pyramids match the frame's one on their cores
+void splitPyramidTiles(const cv::Size &frameSize, const int levels, int tileSize,
+                       std::vector<PyramidTile> &tiles);
+
+// build a gaussian pyramid, reusing the levels no other header shares
 bool buildGaussianPyramid(const cv::Mat &img, const int levels,
                            std::vector<cv::Mat> &pyramid);
 
@@ -32,12 +61,26 @@ bool buildGaussianPyramid(const cv::Mat &img, const int levels,
 bool buildLaplacianPyramid(const cv::Mat &img, const int levels,
                            std::vector<cv::Mat> &pyramid);
 
+// build a laplacian pyramid into reused buffers
+bool buildLaplacianPyramid(const cv::Mat &img, const int levels,
+                           std::vector<cv::Mat> &pyramid,
+                           PyramidWorkspace &workspace);
+
 // reconstruct an image from a laplacian pyramid
 void reconImgFromLaplacianPyramid(const std::vector<cv::Mat> &pyramid, const int levels,
                                   cv::Mat &dst);
 
+// reconstruct an image from a laplacian pyramid using reused buffers
+void reconImgFromLaplacianPyramid(const std::vector<cv::Mat> &pyramid, const int levels,
+                                  cv::Mat &dst, PyramidWorkspace &workspace);
+
 // up-sampling an image from gaussian pyramid
 void upsamplingFromGaussianPyramid(const cv::Mat &src, const int levels,
                                    cv::Mat &dst);
 
+// up-sampling an image from gaussian pyramid using reused buffers,
+// dst is reused unless another header shares it
+void upsamplingFromGaussianPyramid(const cv::Mat &src, const int levels,
+                                   cv::Mat &dst, PyramidWorkspace &workspace);
+
 #endif // SPATIALFILTER_H
@@ -0,0 +1,190 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "StageProfiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+StageProfiler::StageProfiler()
+    : enabled(false)
+{
+}
+
+/**
+ * setEnabled	-	start or stop recording
+ *
+ * @param enabled	-	true to record the stages
+ */
+void StageProfiler::setEnabled(bool enabled)
+{
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * clear	-	forget the recorded events
+ *
+ */
+void StageProfiler::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    recorded.clear();
+}
+
+/**
+ * record	-	record a run of a stage
+ *
+ * @param stage	-	name of the stage, must outlive the profiler
+ * @param frame	-	frame being processed, -1 if none
+ * @param start	-	start time, from now()
+ * @param end	-	end time, from now()
+ */
+void StageProfiler::record(const char *stage, long frame, int64_t start, int64_t end)
+{
+    StageEvent event;
+    event.stage = stage;
+    event.frame = frame;
+    event.start = start;
+    event.duration = end - start;
+    event.thread = std::this_thread::get_id();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (recorded.capacity() == recorded.size())
+        recorded.reserve(std::max(recorded.size() * 2, (size_t)4096));
+    recorded.push_back(event);
+}
+
+/**
+ * events	-	the recorded events
+ *
+ * @return a copy of the events, in the order they ended
+ */
+std::vector<StageEvent> StageProfiler::events()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return recorded;
+}
+
+/**
+ * writeChromeTrace	-	write the events as Chrome trace-event JSON
+ *
+ * The file can be opened in chrome://tracing or Perfetto.
+ * Every thread gets its own track.
+ *
+ * @param fileName	-	the destinate file
+ *
+ * @return true if success
+ */
+bool StageProfiler::writeChromeTrace(const std::string &fileName)
+{
+    std::vector<StageEvent> all = events();
+
+    FILE *file = fopen(fileName.c_str(), "w");
+    if (!file) {
+        perror(fileName.c_str());
+        return false;
+    }
+
+    int64_t origin = 0;
+    for (size_t i = 0; i < all.size(); ++i)
+        if (i == 0 || all[i].start < origin)
+            origin = all[i].start;
+
+    std::vector<std::thread::id> threads;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (size_t i = 0; i < all.size(); ++i) {
+        const StageEvent &e = all[i];
+        size_t tid = std::find(threads.begin(), threads.end(), e.thread) - threads.begin();
+        if (tid == threads.size())
+            threads.push_back(e.thread);
+        fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"evm\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"frame\":%ld}}",
+                i ? "," : "", e.stage, (e.start - origin) / 1e3,
+                e.duration / 1e3, (int)tid + 1, e.frame);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0)
+        ok = false;
+    return ok;
+}
+
+/**
+ * summary	-	percentiles of each stage
+ *
+ * @return a table with the count, mean, p50, p95, p99 and total
+ *         of each stage in milliseconds, in order of appearance
+ */
+std::string StageProfiler::summary()
+{
+    std::vector<StageEvent> all = events();
+
+    std::vector<const char *> stages;
+    std::vector<std::vector<int64_t> > durations;
+    for (size_t i = 0; i < all.size(); ++i) {
+        size_t s = 0;
+        while (s < stages.size() && strcmp(stages[s], all[i].stage) != 0)
+            ++s;
+        if (s == stages.size()) {
+            stages.push_back(all[i].stage);
+            durations.push_back(std::vector<int64_t>());
+        }
+        durations[s].push_back(all[i].duration);
+    }
+
+    std::string table;
+    char line[256];
+    snprintf(line, sizeof(line), "%-16s %8s %10s %10s %10s %10s %12s\n",
+             "stage", "count", "mean", "p50", "p95", "p99", "total");
+    table += line;
+    for (size_t s = 0; s < stages.size(); ++s) {
+        std::vector<int64_t> &d = durations[s];
+        std::sort(d.begin(), d.end());
+        double total = 0;
+        for (size_t i = 0; i < d.size(); ++i)
+            total += d[i];
+        // nearest-rank percentiles
+        double p[3] = {0.50, 0.95, 0.99};
+        double ms[3];
+        for (int k = 0; k < 3; ++k) {
+            size_t rank = (size_t)std::max(1.0, std::ceil(p[k] * d.size()));
+            ms[k] = d[rank - 1] / 1e6;
+        }
+        snprintf(line, sizeof(line), "%-16s %8d %10.3f %10.3f %10.3f %10.3f %12.1f\n",
+                 stages[s], (int)d.size(), total / d.size() / 1e6,
+                 ms[0], ms[1], ms[2], total / 1e6);
+        table += line;
+    }
+    return table;
+}
+
+/**
+ * now	-	monotonic time
+ *
+ * @return nanoseconds since an arbitrary origin
+ */
+int64_t StageProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,143 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef STAGEPROFILER_H
+#define STAGEPROFILER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+// one timed run of a stage
+struct StageEvent {
+    // name of the stage, a string literal
+    const char *stage;
+    // frame being processed, -1 if none
+    long frame;
+    // start and duration in nanoseconds
+    int64_t start;
+    int64_t duration;
+    // thread which ran it
+    std::thread::id thread;
+};
+
+/**
+ * StageProfiler	-	records how long each processing stage takes
+ *
+ * Disabled by default. While it is disabled a StageTimer costs
+ * one relaxed atomic load, so the timers are always compiled in.
+ * Events can be recorded from any thread.
+ */
+class StageProfiler {
+public:
+    StageProfiler();
+
+    // start or stop recording
+    void setEnabled(bool enabled);
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // forget the recorded events
+    void clear();
+
+    // record an event, times from now()
+    void record(const char *stage, long frame, int64_t start, int64_t end);
+
+    // the recorded events
+    std::vector<StageEvent> events();
+
+    // write the events as Chrome trace-event JSON
+    bool writeChromeTrace(const std::string &fileName);
+
+    // percentiles of each stage as a table
+    std::string summary();
+
+    // monotonic time in nanoseconds
+    static int64_t now();
+
+private:
+    StageProfiler(const StageProfiler &);
+    StageProfiler &operator=(const StageProfiler &);
+
+    std::atomic<bool> enabled;
+    std::mutex mutex;
+    std::vector<StageEvent> recorded;
+};
+
+/**
+ * StageTimer	-	times consecutive stages of one frame
+ *
+ * begin() ends the running stage and starts the next one,
+ * the last one ends with end() or when the timer goes out of scope.
+ */
+class StageTimer {
+public:
+    StageTimer(StageProfiler &profiler, long frame, const char *stage = 0)
+        : profiler(profiler)
+        , frame(frame)
+        , stage(0)
+        , start(0)
+    {
+        if (stage)
+            begin(stage);
+    }
+
+    ~StageTimer()
+    {
+        end();
+    }
+
+    // end the running stage and start another one
+    void begin(const char *next)
+    {
+        if (!profiler.isEnabled()) {
+            stage = 0;
+            return;
+        }
+        int64_t t = StageProfiler::now();
+        if (stage)
+            profiler.record(stage, frame, start, t);
+        stage = next;
+        start = t;
+    }
+
+    // end the running stage
+    void end()
+    {
+        if (stage && profiler.isEnabled())
+            profiler.record(stage, frame, start, StageProfiler::now());
+        stage = 0;
+    }
+
+private:
+    StageTimer(const StageTimer &);
+    StageTimer &operator=(const StageTimer &);
+
+    StageProfiler &profiler;
+    long frame;
+    const char *stage;
+    int64_t start;
+};
+
+#endif // STAGEPROFILER_H
@@ -0,0 +1,196 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "TemporalFFT.h"
+#include <algorithm>
+
+// number of pixels transformed together
+static const int BLOCK_PIXELS = 256;
+
+// plans kept at most, streaming windows and previews use a few lengths
+static const size_t MAX_PLANS = 8;
+
+/**
+ * TemporalFFT::BlockFilter	-	filters blocks of BLOCK_PIXELS rows
+ *
+ * Each block is gathered into a scratch matrix of one real series per
+ * row and channel, transformed forward and back with DFT_ROWS, and
+ * scattered back into the interleaved destination.
+ */
+class TemporalFFT::BlockFilter : public cv::ParallelLoopBody {
+public:
+    BlockFilter(const cv::Mat &src, cv::Mat &dst, const Plan &plan,
+                const std::atomic<bool> *cancel)
+        : src(src), dst(dst), plan(plan), cancel(cancel)
+    {
+    }
+
+    void operator()(const cv::Range &range) const
+    {
+        const int cn = src.channels();
+        const int length = src.cols;
+        const int padded = plan.padded;
+        const float *mask = plan.mask.ptr<float>(0);
+
+        // scratch block, zero beyond the series length
+        cv::Mat block = cv::Mat::zeros(BLOCK_PIXELS * cn, padded, CV_32F);
+
+        for (int b = range.start; b < range.end; ++b) {
+            if (cancel && cancel->load(std::memory_order_relaxed))
+                return;
+            int r0 = b * BLOCK_PIXELS;
+            int rows = std::min(BLOCK_PIXELS, src.rows - r0);
+            cv::Mat series = block.rowRange(0, rows * cn);
+
+            // gather: de-interleave the channels of each pixel
+            for (int r = 0; r < rows; ++r) {
+                const float *in = src.ptr<float>(r0 + r);
+                for (int c = 0; c < cn; ++c) {
+                    float *out = series.ptr<float>(r * cn + c);
+                    for (int t = 0; t < length; ++t)
+                        out[t] = in[t * cn + c];
+                    for (int t = length; t < padded; ++t)
+                        out[t] = 0;
+                }
+            }
+
+            // real to complex, in CCS layout
+            cv::dft(series, series, cv::DFT_ROWS);
+
+            // zero the bins out of the band
+            for (int i = 0; i < series.rows; ++i) {
+                float *row = series.ptr<float>(i);
+                for (int j = 0; j < padded; ++j)
+                    row[j] *= mask[j];
+            }
+
+            // complex to real
+            cv::dft(series, series, cv::DFT_INVERSE | cv::DFT_ROWS
+                    | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+            // scatter: interleave the channels again
+            for (int r = 0; r < rows; ++r) {
+                float *out = dst.ptr<float>(r0 + r);
+                for (int c = 0; c < cn; ++c) {
+                    const float *in = series.ptr<float>(r * cn + c);
+                    for (int t = 0; t < length; ++t)
+                        out[t * cn + c] = in[t];
+                }
+            }
+        }
+    }
+
+private:
+    const cv::Mat &src;
+    cv::Mat &dst;
+    const Plan &plan;
+    const std::atomic<bool> *cancel;
+};
+
+TemporalFFT::TemporalFFT()
+    : ticks(0)
+    , cancel(0)
+{
+}
+
+/**
+ * setCancelFlag	-	give up filtering once a flag is raised
+ *
+ * The flag is checked between blocks of rows. A cancelled
+ * filtering leaves dst incomplete.
+ *
+ * @param flag	-	the flag, null never to give up
+ */
+void TemporalFFT::setCancelFlag(const std::atomic<bool> *flag)
+{
+    cancel = flag;
+}
+
+/**
+ * plan	-	get the plan for a series length
+ *
+ * The padded length is computed once per length, the mask
+ * again only when the band or the rate changes. Beyond
+ * MAX_PLANS lengths, the least recently used plan is dropped.
+ *
+ * @param length	-	series length
+ * @param fl        -	low cut-off
+ * @param fh        -	high cut-off
+ * @param rate      -	sampling rate(i.e. video frame rate)
+ *
+ * @return the plan
+ */
+TemporalFFT::Plan &TemporalFFT::plan(int length, double fl, double fh, double rate)
+{
+    std::map<int, Plan>::iterator it = plans.find(length);
+    if (it == plans.end()) {
+        if (plans.size() >= MAX_PLANS) {
+            std::map<int, Plan>::iterator oldest = plans.begin();
+            for (std::map<int, Plan>::iterator i = plans.begin(); i != plans.end(); ++i)
+                if (i->second.used < oldest->second.used)
+                    oldest = i;
+            plans.erase(oldest);
+        }
+        Plan p;
+        p.padded = cv::getOptimalDFTSize(length);
+        p.fl = p.fh = p.rate = -1;
+        it = plans.insert(std::make_pair(length, p)).first;
+    }
+
+    Plan &p = it->second;
+    p.used = ++ticks;
+    if (p.fl != fl || p.fh != fh || p.rate != rate) {
+        // CCS layout of a real DFT row: Re0, Re1, Im1, Re2, Im2, ...
+        // (and a last lone real value when the length is even)
+        int n = p.padded;
+        p.mask.create(1, n, CV_32F);
+        float *mask = p.mask.ptr<float>(0);
+        for (int j = 0; j < n; ++j) {
+            int bin = (j + 1) / 2;
+            double freq = bin * rate / n;
+            mask[j] = (freq >= fl && freq <= fh) ? 1.0f : 0.0f;
+        }
+        p.fl = fl;
+        p.fh = fh;
+        p.rate = rate;
+    }
+    return p;
+}
+
+/**
+ * idealBandpass	-	ideal bandpass filtering of every row of src
+ *
+ * @param src	-	time series, one pixel per row (CV_32FC(n))
+ * @param dst	-	filtered time series, may be src itself
+ * @param fl	-	low cut-off
+ * @param fh	-	high cut-off
+ * @param rate	-	sampling rate(i.e. video frame rate)
+ */
+void TemporalFFT::idealBandpass(const cv::Mat &src, cv::Mat &dst,
+                                double fl, double fh, double rate)
+{
+    CV_Assert(src.depth() == CV_32F);
+    dst.create(src.size(), src.type());
+    if (src.empty())
+        return;
+
+    const Plan &p = plan(src.cols, fl, fh, rate);
+    int blocks = (src.rows + BLOCK_PIXELS - 1) / BLOCK_PIXELS;
+    cv::parallel_for_(cv::Range(0, blocks), BlockFilter(src, dst, p, cancel));
+}
@@ -0,0 +1,73 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef TEMPORALFFT_H
+#define TEMPORALFFT_H
+
+#include <map>
+#include <atomic>
+#include <opencv2/core/core.hpp>
+
+/**
+ * TemporalFFT	-	ideal bandpass filtering along the time axis
+ *
+ * Works on a matrix whose rows are the time series of single pixels
+ * (cols = time), with the color channels left interleaved. Rows are
+ * gathered into blocks of real series, transformed with real-to-complex
+ * DFTs and filtered by zeroing bins in place. Everything that depends
+ * only on the series length (padded length, band mask) is kept in a plan
+ * cached per length.
+ */
+class TemporalFFT {
+public:
+    TemporalFFT();
+
+    // ideal bandpass filtering of every row of src
+    void idealBandpass(const cv::Mat &src, cv::Mat &dst,
+                       double fl, double fh, double rate);
+
+    // give up filtering, leaving dst incomplete, once flag is raised
+    void setCancelFlag(const std::atomic<bool> *flag);
+
+private:
+    // per-length state
+    struct Plan {
+        // padded transform length
+        int padded;
+        // band of the mask
+        double fl, fh, rate;
+        // one-row mask in CCS layout, broadcast to every series
+        cv::Mat mask;
+        // tick of the last use, for eviction
+        unsigned long used;
+    };
+
+    // get the plan for a series length, updating its mask if needed
+    Plan &plan(int length, double fl, double fh, double rate);
+
+    std::map<int, Plan> plans;
+    // counts plan lookups
+    unsigned long ticks;
+    // raised to cancel the filtering, may be null
+    const std::atomic<bool> *cancel;
+
+    class BlockFilter;
+};
+
+#endif // TEMPORALFFT_H
@@ -0,0 +1,485 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "TemporalFilter.h"
+#include "Precision.h"
+#include <math.h>
+#include <complex>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define EVM_HAVE_SSE2 1
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define EVM_HAVE_AVX2_DISPATCH 1
+#endif
+
+#if defined(EVM_HAVE_SSE2) || defined(EVM_HAVE_AVX2_DISPATCH)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EVM_HAVE_NEON 1
+#endif
+
+// the per-row kernel: src, lowpassHi, lowpassLo, dst, length, fl, fh, gain
+typedef void (*IIRRowKernel)(const float *, float *, float *, float *,
+                             int, float, float, float);
+
+/**
+ * iirRowScalar	-	IIR bandpass update of one row, portable version
+ *
+ * Also finishes the tail of the vectorized versions.
+ */
+static void iirRowScalar(const float *src, float *hi, float *lo, float *dst,
+                         int n, float fl, float fh, float gain)
+{
+    for (int i = 0; i < n; ++i) {
+        float h = (1 - fh) * hi[i] + fh * src[i];
+        float l = (1 - fl) * lo[i] + fl * src[i];
+        hi[i] = h;
+        lo[i] = l;
+        dst[i] = gain * (h - l);
+    }
+}
+
+#ifdef EVM_HAVE_SSE2
+/**
+ * iirRowSSE2	-	IIR bandpass update of one row, 4 floats at a time
+ */
+static void iirRowSSE2(const float *src, float *hi, float *lo, float *dst,
+                       int n, float fl, float fh, float gain)
+{
+    const __m128 vfh = _mm_set1_ps(fh), vfh1 = _mm_set1_ps(1 - fh);
+    const __m128 vfl = _mm_set1_ps(fl), vfl1 = _mm_set1_ps(1 - fl);
+    const __m128 vgain = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i <= n - 4; i += 4) {
+        __m128 s = _mm_loadu_ps(src + i);
+        __m128 h = _mm_add_ps(_mm_mul_ps(vfh1, _mm_loadu_ps(hi + i)), _mm_mul_ps(vfh, s));
+        __m128 l = _mm_add_ps(_mm_mul_ps(vfl1, _mm_loadu_ps(lo + i)), _mm_mul_ps(vfl, s));
+        _mm_storeu_ps(hi + i, h);
+        _mm_storeu_ps(lo + i, l);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(vgain, _mm_sub_ps(h, l)));
+    }
+    iirRowScalar(src + i, hi + i, lo + i, dst + i, n - i, fl, fh, gain);
+}
+#endif
+
+#ifdef EVM_HAVE_AVX2_DISPATCH
+/**
+ * iirRowAVX2	-	IIR bandpass update of one row, 8 floats at a time
+ *
+ * Compiled for AVX2/FMA regardless of the build flags,
+ * and only called when the CPU supports them.
+ */
+__attribute__((target("avx2,fma")))
+static void iirRowAVX2(const float *src, float *hi, float *lo, float *dst,
+                       int n, float fl, float fh, float gain)
+{
+    const __m256 vfh = _mm256_set1_ps(fh), vfh1 = _mm256_set1_ps(1 - fh);
+    const __m256 vfl = _mm256_set1_ps(fl), vfl1 = _mm256_set1_ps(1 - fl);
+    const __m256 vgain = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i <= n - 8; i += 8) {
+        __m256 s = _mm256_loadu_ps(src + i);
+        __m256 h = _mm256_fmadd_ps(vfh1, _mm256_loadu_ps(hi + i), _mm256_mul_ps(vfh, s));
+        __m256 l = _mm256_fmadd_ps(vfl1, _mm256_loadu_ps(lo + i), _mm256_mul_ps(vfl, s));
+        _mm256_storeu_ps(hi + i, h);
+        _mm256_storeu_ps(lo + i, l);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(vgain, _mm256_sub_ps(h, l)));
+    }
+    iirRowScalar(src + i, hi + i, lo + i, dst + i, n - i, fl, fh, gain);
+}
+#endif
+
+#ifdef EVM_HAVE_NEON
+/**
+ * iirRowNEON	-	IIR bandpass update of one row, 4 floats at a time
+ */
+static void iirRowNEON(const float *src, float *hi, float *lo, float *dst,
+                       int n, float fl, float fh, float gain)
+{
+    const float32x4_t vfh = vdupq_n_f32(fh), vfh1 = vdupq_n_f32(1 - fh);
+    const float32x4_t vfl = vdupq_n_f32(fl), vfl1 = vdupq_n_f32(1 - fl);
+    int i = 0;
+    for (; i <= n - 4; i += 4) {
+        float32x4_t s = vld1q_f32(src + i);
+        float32x4_t h = vmlaq_f32(vmulq_f32(vfh, s), vfh1, vld1q_f32(hi + i));
+        float32x4_t l = vmlaq_f32(vmulq_f32(vfl, s), vfl1, vld1q_f32(lo + i));
+        vst1q_f32(hi + i, h);
+        vst1q_f32(lo + i, l);
+        vst1q_f32(dst + i, vmulq_n_f32(vsubq_f32(h, l), gain));
+    }
+    iirRowScalar(src + i, hi + i, lo + i, dst + i, n - i, fl, fh, gain);
+}
+#endif
+
+/**
+ * selectIIRRowKernel	-	pick the widest row kernel the CPU runs
+ *
+ * @return the row kernel
+ */
+static IIRRowKernel selectIIRRowKernel()
+{
+#ifdef EVM_HAVE_AVX2_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return iirRowAVX2;
+#endif
+#if defined(EVM_HAVE_SSE2)
+    return iirRowSSE2;
+#elif defined(EVM_HAVE_NEON)
+    return iirRowNEON;
+#else
+    return iirRowScalar;
+#endif
+}
+
+/**
+ * iirBandpass	-	one step of the IIR bandpass filter
+ *
+ * Updates lowpassHi = (1-fh)*lowpassHi + fh*src and
+ * lowpassLo = (1-fl)*lowpassLo + fl*src in place, and writes
+ * dst = gain*(lowpassHi - lowpassLo), all in a single pass.
+ * Any of the Mats may be ROIs, nothing is allocated as long
+ * as dst already has the size and type of src.
+ *
+ * The states may be kept in reduced precision (see packImage):
+ * each row is then widened to floats, filtered and stored back.
+ *
+ * @param src       -	source image (CV_32F, any channels)
+ * @param lowpassHi	-	state of the low pass filter at fh
+ * @param lowpassLo	-	state of the low pass filter at fl
+ * @param dst       -	destinate image
+ * @param fl        -	low cut-off
+ * @param fh        -	high cut-off
+ * @param gain      -	amplification of the band
+ */
+void iirBandpass(const cv::Mat &src, cv::Mat &lowpassHi, cv::Mat &lowpassLo,
+                 cv::Mat &dst, float fl, float fh, float gain)
+{
+    static const IIRRowKernel kernel = selectIIRRowKernel();
+
+    CV_Assert(src.depth() == CV_32F);
+    CV_Assert(lowpassHi.size() == src.size() && lowpassLo.size() == src.size());
+    CV_Assert(lowpassHi.type() == lowpassLo.type());
+    CV_Assert(lowpassHi.channels() == src.channels());
+    dst.create(src.size(), src.type());
+
+    int n = src.cols * src.channels();
+    if (lowpassHi.depth() == CV_32F) {
+        for (int y = 0; y < src.rows; ++y) {
+            kernel(src.ptr<float>(y), lowpassHi.ptr<float>(y), lowpassLo.ptr<float>(y),
+                   dst.ptr<float>(y), n, fl, fh, gain);
+        }
+        return;
+    }
+
+    storagePrecision precision = storedPrecision(lowpassHi.type());
+    cv::AutoBuffer<float> states(2 * n);
+    float *hi = states, *lo = hi + n;
+    for (int y = 0; y < src.rows; ++y) {
+        unpackRow(lowpassHi.ptr(y), hi, n, precision);
+        unpackRow(lowpassLo.ptr(y), lo, n, precision);
+        kernel(src.ptr<float>(y), hi, lo, dst.ptr<float>(y), n, fl, fh, gain);
+        packRow(hi, lowpassHi.ptr(y), n, precision);
+        packRow(lo, lowpassLo.ptr(y), n, precision);
+    }
+}
+
+// highest order of the Butterworth filters
+static const int MAX_BUTTERWORTH_ORDER = 8;
+
+/**
+ * lowpassSection	-	second-order lowpass section
+ *
+ * The bilinear transform of 1 / (s^2 + s/q + 1),
+ * pre-warped at the cut-off.
+ *
+ * @param w0	-	cut-off in radians per frame
+ * @param q     -	quality factor of the pole pair
+ */
+static Biquad lowpassSection(double w0, double q)
+{
+    double c = cos(w0), alpha = sin(w0) / (2 * q), a0 = 1 + alpha;
+    Biquad s;
+    s.b0 = (1 - c) / 2 / a0;
+    s.b1 = (1 - c) / a0;
+    s.b2 = s.b0;
+    s.a1 = -2 * c / a0;
+    s.a2 = (1 - alpha) / a0;
+    return s;
+}
+
+/**
+ * highpassSection	-	second-order highpass section
+ *
+ * The bilinear transform of s^2 / (s^2 + s/q + 1),
+ * pre-warped at the cut-off.
+ *
+ * @param w0	-	cut-off in radians per frame
+ * @param q     -	quality factor of the pole pair
+ */
+static Biquad highpassSection(double w0, double q)
+{
+    double c = cos(w0), alpha = sin(w0) / (2 * q), a0 = 1 + alpha;
+    Biquad s;
+    s.b0 = (1 + c) / 2 / a0;
+    s.b1 = -(1 + c) / a0;
+    s.b2 = s.b0;
+    s.a1 = -2 * c / a0;
+    s.a2 = (1 - alpha) / a0;
+    return s;
+}
+
+/**
+ * firstOrderSection	-	first-order lowpass or highpass section,
+ *                          the real pole of an odd order
+ *
+ * @param w0        -	cut-off in radians per frame
+ * @param highpass	-	true for a highpass
+ */
+static Biquad firstOrderSection(double w0, bool highpass)
+{
+    double k = tan(w0 / 2);
+    Biquad s;
+    s.b0 = highpass ? 1 / (1 + k) : k / (1 + k);
+    s.b1 = highpass ? -s.b0 : s.b0;
+    s.b2 = 0;
+    s.a1 = (k - 1) / (k + 1);
+    s.a2 = 0;
+    return s;
+}
+
+/**
+ * butterworthSections	-	append the sections of a Butterworth filter
+ *
+ * @param w0        -	cut-off in radians per frame
+ * @param order     -	order of the filter
+ * @param highpass	-	true for a highpass
+ * @param sections	-	the sections to append to
+ */
+static void butterworthSections(double w0, int order, bool highpass,
+                                std::vector<Biquad> &sections)
+{
+    for (int k = 0; k < order / 2; ++k) {
+        double q = 1 / (2 * sin((2 * k + 1) * CV_PI / (2 * order)));
+        sections.push_back(highpass ? highpassSection(w0, q) : lowpassSection(w0, q));
+    }
+    if (order % 2)
+        sections.push_back(firstOrderSection(w0, highpass));
+}
+
+/**
+ * bandpassSection	-	second-order bandpass section
+ *
+ * The bilinear transform of bw * s / (s^2 + a*s + b).
+ * The frequencies are pre-warped, i.e. tan(pi * f / rate).
+ *
+ * @param a     -	first-order coefficient of the analog denominator
+ * @param b     -	constant of the analog denominator
+ * @param bw	-	pre-warped bandwidth
+ */
+static Biquad bandpassSection(double a, double b, double bw)
+{
+    double a0 = 1 + a + b;
+    Biquad s;
+    s.b0 = bw / a0;
+    s.b1 = 0;
+    s.b2 = -s.b0;
+    s.a1 = (2 * b - 2) / a0;
+    s.a2 = (1 - a + b) / a0;
+    return s;
+}
+
+/**
+ * bandpassSections	-	append the sections of a Butterworth bandpass
+ *
+ * The lowpass prototype of the given order is mapped to a bandpass
+ * of twice that order, s -> (s^2 + wl*wh) / (bw * s), whose gain is 1
+ * at the centre even for a narrow band.
+ *
+ * @param wl        -	pre-warped low cut-off
+ * @param wh        -	pre-warped high cut-off
+ * @param order     -	order of the prototype
+ * @param sections	-	the sections to append to
+ */
+static void bandpassSections(double wl, double wh, int order,
+                             std::vector<Biquad> &sections)
+{
+    double bw = wh - wl, centre2 = wl * wh;
+    for (int k = 0; k < order; ++k) {
+        // prototype poles on the left unit half circle, scaled by bw;
+        // the ones below the real axis are the conjugates of those above
+        double theta = CV_PI * (2 * k + order + 1) / (2 * order);
+        std::complex<double> p = std::polar(bw, theta);
+        if (p.imag() < -1e-12 * bw)
+            continue;
+        if (p.imag() <= 1e-12 * bw) {
+            // a real pole maps to the real quadratic s^2 - p*s + wl*wh
+            sections.push_back(bandpassSection(-p.real(), centre2, bw));
+        } else {
+            // a complex pole maps to two poles s1, s2 with s1*s2 = wl*wh,
+            // each paired with its conjugate
+            std::complex<double> root = std::sqrt(p * p - 4 * centre2);
+            std::complex<double> s1 = (p + root) / 2.0, s2 = (p - root) / 2.0;
+            sections.push_back(bandpassSection(-2 * s1.real(), std::norm(s1), bw));
+            sections.push_back(bandpassSection(-2 * s2.real(), std::norm(s2), bw));
+        }
+    }
+}
+
+ButterworthBandpass::ButterworthBandpass()
+    : rate(0)
+{
+}
+
+/**
+ * design	-	design the filter
+ *
+ * A cut-off out of (0, rate/2) drops its side of the band,
+ * i.e. fl <= 0 gives a lowpass at fh.
+ *
+ * @param fl	-	low cut-off in Hz
+ * @param fh	-	high cut-off in Hz
+ * @param rate	-	frame rate in Hz
+ * @param order	-	order of the lowpass prototype, 1 to 8;
+ *                  the bandpass has twice as many poles
+ */
+void ButterworthBandpass::design(double fl, double fh, double rate, int order)
+{
+    CV_Assert(rate > 0);
+    order = std::min(std::max(order, 1), MAX_BUTTERWORTH_ORDER);
+    this->rate = rate;
+    sections.clear();
+    state.release();
+
+    double nyquist = rate / 2;
+    bool low = fl > 0 && fl < nyquist;
+    bool high = fh > 0 && fh < nyquist;
+    if (low && high && fl < fh)
+        bandpassSections(tan(CV_PI * fl / rate), tan(CV_PI * fh / rate), order, sections);
+    else if (low)
+        butterworthSections(2 * CV_PI * fl / rate, order, true, sections);
+    else if (high)
+        butterworthSections(2 * CV_PI * fh / rate, order, false, sections);
+}
+
+/**
+ * reset	-	start from the steady state of a still first frame
+ *
+ * As if the first frame had always been there, so that
+ * the start of the video isn't a step for the filter.
+ *
+ * @param first	-	the first frame (CV_32F, any channels)
+ */
+void ButterworthBandpass::reset(const cv::Mat &first)
+{
+    CV_Assert(first.depth() == CV_32F);
+    int n = first.cols * first.channels();
+    int count = (int)sections.size();
+    state.create(first.rows, 2 * n * count, CV_64F);
+
+    for (int y = 0; y < first.rows; ++y) {
+        const float *src = first.ptr<float>(y);
+        double *z = state.ptr<double>(y);
+        for (int i = 0; i < n; ++i) {
+            double x = src[i];
+            for (int s = 0; s < count; ++s) {
+                const Biquad &b = sections[s];
+                // the output of a section at rest is its DC gain times x
+                double out = x * (b.b0 + b.b1 + b.b2) / (1 + b.a1 + b.a2);
+                double *zs = z + 2 * (s * n + i);
+                zs[0] = out - b.b0 * x;
+                zs[1] = b.b2 * x - b.a2 * out;
+                x = out;
+            }
+        }
+    }
+}
+
+/**
+ * apply	-	filter the next frame
+ *
+ * The first frame, or a frame of another size, resets the states.
+ *
+ * @param src	-	source frame (CV_32F, any channels)
+ * @param dst	-	the band, amplified
+ * @param gain	-	amplification of the band
+ */
+void ButterworthBandpass::apply(const cv::Mat &src, cv::Mat &dst, float gain)
+{
+    CV_Assert(src.depth() == CV_32F);
+    int n = src.cols * src.channels();
+    int count = (int)sections.size();
+    if (state.rows != src.rows || state.cols != 2 * n * count || state.empty())
+        reset(src);
+    dst.create(src.size(), src.type());
+
+    cv::AutoBuffer<double> buffer(n);
+    double *x = buffer;
+    for (int y = 0; y < src.rows; ++y) {
+        const float *in = src.ptr<float>(y);
+        for (int i = 0; i < n; ++i)
+            x[i] = in[i];
+        // transposed direct form II, one section at a time
+        double *z = state.ptr<double>(y);
+        for (int s = 0; s < count; ++s) {
+            const Biquad &b = sections[s];
+            double *zs = z + 2 * s * n;
+            for (int i = 0; i < n; ++i) {
+                double v = x[i];
+                double out = b.b0 * v + zs[2*i];
+                zs[2*i] = b.b1 * v - b.a1 * out + zs[2*i+1];
+                zs[2*i+1] = b.b2 * v - b.a2 * out;
+                x[i] = out;
+            }
+        }
+        float *out = dst.ptr<float>(y);
+        for (int i = 0; i < n; ++i)
+            out[i] = (float)(gain * x[i]);
+    }
+}
+
+/**
+ * response	-	magnitude of the frequency response
+ *
+ * @param frequency	-	frequency in Hz
+ *
+ * @return the gain of the filter at frequency
+ */
+double ButterworthBandpass::response(double frequency) const
+{
+    if (rate <= 0)
+        return 1;
+    double w = 2 * CV_PI * frequency / rate;
+    double gain = 1;
+    for (size_t s = 0; s < sections.size(); ++s) {
+        const Biquad &b = sections[s];
+        // H(e^jw) = (b0 + b1 e^-jw + b2 e^-2jw) / (1 + a1 e^-jw + a2 e^-2jw)
+        double nr = b.b0 + b.b1 * cos(w) + b.b2 * cos(2 * w);
+        double ni = -b.b1 * sin(w) - b.b2 * sin(2 * w);
+        double dr = 1 + b.a1 * cos(w) + b.a2 * cos(2 * w);
+        double di = -b.a1 * sin(w) - b.a2 * sin(2 * w);
+        gain *= sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+    }
+    return gain;
+}
@@ -0,0 +1,73 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt. 
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+// 
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+// 
+
+#ifndef TEMPORALFILTER_H
+#define TEMPORALFILTER_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// one step of the IIR bandpass filter, updating both low pass
+// states in place and writing the (amplified) band to dst;
+// the states are CV_32F or stored in a reduced precision
+void iirBandpass(const cv::Mat &src, cv::Mat &lowpassHi, cv::Mat &lowpassLo,
+                 cv::Mat &dst, float fl, float fh, float gain = 1.0f);
+
+// a second-order IIR section, normalized so that a0 = 1
+struct Biquad {
+    double b0, b1, b2;
+    double a1, a2;
+};
+
+/**
+ * ButterworthBandpass	-	causal Butterworth bandpass filtering of frames
+ *
+ * A Butterworth lowpass prototype mapped to a bandpass from fl to fh,
+ * made of cascaded second-order sections, twice the order of poles.
+ * When only one cut-off lies in (0, rate/2), it is a plain highpass
+ * at fl or lowpass at fh instead.
+ * Every value of a frame keeps two states per section, in doubles as
+ * the low cut-off is a tiny fraction of the frame rate. Frames are
+ * filtered one at a time, so the memory doesn't grow with the video.
+ */
+class ButterworthBandpass {
+public:
+    ButterworthBandpass();
+
+    // design the filter, cut-offs in Hz
+    void design(double fl, double fh, double rate, int order);
+
+    // start from the steady state of a still first frame
+    void reset(const cv::Mat &first);
+
+    // filter the next frame, dst = gain * band
+    void apply(const cv::Mat &src, cv::Mat &dst, float gain = 1.0f);
+
+    // magnitude of the frequency response at a frequency in Hz
+    double response(double frequency) const;
+
+private:
+    std::vector<Biquad> sections;
+    double rate;
+    // states of the sections, each row holds the
+    // states of a frame row, section after section
+    cv::Mat state;
+};
+
+#endif // TEMPORALFILTER_H
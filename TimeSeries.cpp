@@ -0,0 +1,220 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "TimeSeries.h"
+#include <algorithm>
+
+// side of the square blocks of the transpose, in elements
+static const int TRANSPOSE_BLOCK = 32;
+
+// number of frames staged before they are written as series
+static const int STAGE_FRAMES = 16;
+
+// an element of N bytes, copied as a whole
+template <int N>
+struct Element {
+    unsigned char bytes[N];
+};
+
+/**
+ * transposeElements	-	cache-blocked transpose of elements of type T
+ */
+template <typename T>
+static void transposeElements(const cv::Mat &src, cv::Mat &dst)
+{
+    for (int i0 = 0; i0 < src.rows; i0 += TRANSPOSE_BLOCK) {
+        int i1 = std::min(i0 + TRANSPOSE_BLOCK, src.rows);
+        for (int j0 = 0; j0 < src.cols; j0 += TRANSPOSE_BLOCK) {
+            int j1 = std::min(j0 + TRANSPOSE_BLOCK, src.cols);
+            for (int i = i0; i < i1; ++i) {
+                const T *in = src.ptr<T>(i);
+                for (int j = j0; j < j1; ++j)
+                    dst.ptr<T>(j)[i] = in[j];
+            }
+        }
+    }
+}
+
+/**
+ * transposeBlocked	-	cache-blocked transpose of a matrix
+ *
+ * Unlike cv::transpose, any element size used by the filters
+ * (up to 3 channels of 32 bits) is supported, and dst may be
+ * a ROI of a larger matrix.
+ *
+ * @param src	-	source matrix
+ * @param dst	-	destinate matrix, src.cols x src.rows
+ */
+void transposeBlocked(const cv::Mat &src, cv::Mat &dst)
+{
+    dst.create(src.cols, src.rows, src.type());
+    switch (src.elemSize()) {
+    case 1:  transposeElements<Element<1> >(src, dst); break;
+    case 2:  transposeElements<Element<2> >(src, dst); break;
+    case 3:  transposeElements<Element<3> >(src, dst); break;
+    case 4:  transposeElements<Element<4> >(src, dst); break;
+    case 6:  transposeElements<Element<6> >(src, dst); break;
+    case 8:  transposeElements<Element<8> >(src, dst); break;
+    case 12: transposeElements<Element<12> >(src, dst); break;
+    default: cv::transpose(src, dst); break;
+    }
+}
+
+/**
+ * seriesToFrames	-	split pixel-major series into frames
+ *
+ * One blocked transpose into a frame-major buffer, after which
+ * every frame is a contiguous row of it and is returned as a view.
+ *
+ * @param series	-	series, one pixel per row
+ * @param frameSize	-	size of a frame
+ * @param frames	-	views of the frames, appended
+ * @param frameMajor	-	storage of the frames, used in place if it
+ *                          has the right size and type
+ */
+void seriesToFrames(const cv::Mat &series, const cv::Size &frameSize,
+                    std::vector<cv::Mat> &frames,
+                    cv::Mat frameMajor)
+{
+    transposeBlocked(series, frameMajor);
+    for (int i = 0; i < series.cols; ++i)
+        frames.push_back(frameMajor.row(i).reshape(0, frameSize.height));
+}
+
+TimeSeriesBuffer::TimeSeriesBuffer()
+    : staged(0)
+    , count(0)
+{
+}
+
+/**
+ * create	-	prepare for frames of the given size and type
+ *
+ * @param frameSize	-	size of a frame
+ * @param type      -	type of a frame
+ * @param capacity	-	expected number of frames, the buffer
+ *                      grows if more are pushed
+ * @param spillDir	-	directory of the scratch file backing
+ *                      the series, empty to keep them in RAM
+ */
+void TimeSeriesBuffer::create(const cv::Size &frameSize, int type, int capacity,
+                              const std::string &spillDir)
+{
+    size = frameSize;
+    staged = 0;
+    count = 0;
+    this->spillDir = spillDir;
+    staging.create(STAGE_FRAMES, size.area(), type);
+    data = cv::Mat();
+    spill.reset();
+    data = allocate(std::max(capacity, 1));
+}
+
+/**
+ * allocate	-	allocate storage for the series
+ *
+ * Falls back to RAM if the scratch file can't be created.
+ *
+ * @param capacity	-	number of frames
+ *
+ * @return the storage, pixels x capacity
+ */
+cv::Mat TimeSeriesBuffer::allocate(int capacity)
+{
+    int type = staging.type();
+    if (!spillDir.empty()) {
+        std::shared_ptr<ScratchFile> file(new ScratchFile);
+        size_t bytes = size_t(size.area()) * capacity * CV_ELEM_SIZE(type);
+        if (file->open(bytes, spillDir)) {
+            spill = file;
+            return file->mat(0, size.area(), capacity, type);
+        }
+    }
+    return cv::Mat(size.area(), capacity, type);
+}
+
+/**
+ * push	-	append a frame
+ *
+ * @param frame	-	frame of the size and type given to create()
+ */
+void TimeSeriesBuffer::push(const cv::Mat &frame)
+{
+    CV_Assert(frame.size() == size && frame.type() == data.type());
+    cv::Mat row = staging.row(staged).reshape(0, size.height);
+    frame.copyTo(row);
+    if (++staged == STAGE_FRAMES)
+        flush();
+}
+
+/**
+ * flush	-	move the staged frames into the series
+ *
+ */
+void TimeSeriesBuffer::flush()
+{
+    if (staged == 0)
+        return;
+
+    // grow the buffer if the video is longer than expected
+    if (count + staged > data.cols) {
+        // keep the old storage alive until it is copied
+        std::shared_ptr<ScratchFile> oldSpill = spill;
+        cv::Mat grown = allocate(std::max(data.cols * 2, count + staged));
+        cv::Mat old = grown.colRange(0, count);
+        data.colRange(0, count).copyTo(old);
+        data = grown;
+    }
+
+    cv::Mat cols = data.colRange(count, count + staged);
+    transposeBlocked(staging.rowRange(0, staged), cols);
+    count += staged;
+    staged = 0;
+}
+
+/**
+ * series	-	the series of all pushed frames
+ *
+ * @return a view of pixels x length, row i being pixel i over time
+ */
+cv::Mat TimeSeriesBuffer::series()
+{
+    flush();
+    return data.colRange(0, count);
+}
+
+/**
+ * length	-	number of pushed frames
+ *
+ * @return the number of frames
+ */
+int TimeSeriesBuffer::length() const
+{
+    return count + staged;
+}
+
+/**
+ * frameSize	-	size of a frame
+ *
+ * @return the frame size
+ */
+cv::Size TimeSeriesBuffer::frameSize() const
+{
+    return size;
+}
@@ -0,0 +1,89 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <opencv2/core/core.hpp>
+#include "ScratchFile.h"
+
+// cache-blocked transpose of a matrix of any element size
+void transposeBlocked(const cv::Mat &src, cv::Mat &dst);
+
+// split pixel-major series into frames, which are views of one buffer
+void seriesToFrames(const cv::Mat &series, const cv::Size &frameSize,
+                    std::vector<cv::Mat> &frames,
+                    cv::Mat frameMajor = cv::Mat());
+
+/**
+ * TimeSeriesBuffer	-	the frames of a video stored pixel-major
+ *
+ * Row i holds the samples of pixel i over time, so the temporal
+ * filters read every series contiguously. Frames are staged a few at
+ * a time and written with cache-blocked transposes instead of one
+ * strided column per frame. The series may live in a memory-mapped
+ * scratch file when they don't fit in RAM.
+ */
+class TimeSeriesBuffer {
+public:
+    TimeSeriesBuffer();
+
+    // prepare for frames of the given size and type,
+    // spilling to a scratch file in spillDir if not empty
+    void create(const cv::Size &frameSize, int type, int capacity,
+                const std::string &spillDir = std::string());
+
+    // append a frame
+    void push(const cv::Mat &frame);
+
+    // the series of all pushed frames, rows = pixels, cols = time
+    cv::Mat series();
+
+    // number of pushed frames
+    int length() const;
+
+    // size of a frame
+    cv::Size frameSize() const;
+
+private:
+    // move the staged frames into data
+    void flush();
+
+    // allocate pixels x capacity, in RAM or in a scratch file
+    cv::Mat allocate(int capacity);
+
+    // pixels x capacity
+    cv::Mat data;
+    // storage of data when spilled
+    std::shared_ptr<ScratchFile> spill;
+    // directory of the scratch files, empty for RAM
+    std::string spillDir;
+    // staged frames, one per row
+    cv::Mat staging;
+    // number of staged frames
+    int staged;
+    // number of frames in data
+    int count;
+    cv::Size size;
+};
+
+#endif // TIMESERIES_H
@@ -0,0 +1,355 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "VideoProbe.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <sys/stat.h>
+#include <opencv2/highgui/highgui.hpp>
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#endif
+
+// largest moov box or AVI header list read into memory
+static const size_t MAX_HEADER_BYTES = 256 * 1024 * 1024;
+
+// version of the sidecar format
+static const int SIDECAR_VERSION = 1;
+
+static unsigned int le32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned int be32(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static unsigned long long be64(const unsigned char *p)
+{
+    return ((unsigned long long)be32(p) << 32) | be32(p + 4);
+}
+
+static bool isTag(const unsigned char *p, const char *tag)
+{
+    return memcmp(p, tag, 4) == 0;
+}
+
+// read n bytes at an offset
+static bool readAt(FILE *file, long long offset, size_t n, std::vector<unsigned char> &buffer)
+{
+    if (n > MAX_HEADER_BYTES)
+        return false;
+    buffer.resize(n);
+    return fseeko(file, offset, SEEK_SET) == 0 &&
+            fread(buffer.data(), 1, n, file) == n;
+}
+
+// what the headers of an AVI file tell
+struct AviHeaders {
+    AviHeaders() : totalFrames(0), odmlFrames(0), streams(0), videoStream(-1),
+        rate(0), scale(0), length(0) {}
+    // from avih, counts the first RIFF only
+    unsigned int totalFrames;
+    // from dmlh, counts the whole file
+    unsigned int odmlFrames;
+    int streams;
+    int videoStream;
+    // from the strh of the video stream
+    unsigned int rate;
+    unsigned int scale;
+    unsigned int length;
+};
+
+// walk the chunks of an AVI header list
+static void parseAviList(const unsigned char *p, size_t n, AviHeaders &h)
+{
+    size_t pos = 0;
+    while (pos + 8 <= n) {
+        const unsigned char *chunk = p + pos;
+        size_t size = le32(chunk + 4);
+        if (size > n - pos - 8)
+            break;
+        const unsigned char *data = chunk + 8;
+        if (isTag(chunk, "LIST") && size >= 4) {
+            if (isTag(data, "strl"))
+                ++h.streams;
+            parseAviList(data + 4, size - 4, h);
+        } else if (isTag(chunk, "avih") && size >= 20) {
+            h.totalFrames = le32(data + 16);
+        } else if (isTag(chunk, "dmlh") && size >= 4) {
+            h.odmlFrames = le32(data);
+        } else if (isTag(chunk, "strh") && size >= 36 &&
+                   isTag(data, "vids") && h.videoStream < 0) {
+            h.videoStream = h.streams - 1;
+            h.scale = le32(data + 20);
+            h.rate = le32(data + 24);
+            h.length = le32(data + 32);
+        }
+        // chunks are word aligned
+        pos += 8 + size + (size & 1);
+    }
+}
+
+// count the frames of a stream in an idx1 index
+static long countIndexed(const std::vector<unsigned char> &index, int stream)
+{
+    char id[3];
+    snprintf(id, sizeof(id), "%02d", stream);
+    long frames = 0;
+    for (size_t i = 0; i + 16 <= index.size(); i += 16) {
+        const unsigned char *e = &index[i];
+        if (e[0] == id[0] && e[1] == id[1] && (e[2] == 'd' || e[2] == 'D'))
+            ++frames;
+    }
+    return frames;
+}
+
+/**
+ * probeAvi	-	probe an AVI file from its headers
+ *
+ * @param scanned	-	set if the index had to be scanned
+ *
+ * @return false if not an AVI file or it has no usable headers
+ */
+static bool probeAvi(FILE *file, VideoInfo &info, bool &scanned)
+{
+    std::vector<unsigned char> buffer;
+    if (!readAt(file, 0, 12, buffer) || !isTag(&buffer[0], "RIFF") ||
+            !isTag(&buffer[8], "AVI "))
+        return false;
+
+    AviHeaders h;
+    long long indexOffset = -1;
+    size_t indexSize = 0;
+    long long pos = 12;
+    std::vector<unsigned char> chunk;
+    while (readAt(file, pos, 12, chunk)) {
+        size_t size = le32(&chunk[4]);
+        if (isTag(&chunk[0], "LIST") && isTag(&chunk[8], "hdrl") && size >= 4) {
+            std::vector<unsigned char> list;
+            if (!readAt(file, pos + 12, size - 4, list))
+                return false;
+            parseAviList(list.data(), list.size(), h);
+        } else if (isTag(&chunk[0], "idx1")) {
+            indexOffset = pos + 8;
+            indexSize = size;
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    if (h.videoStream < 0 || h.rate == 0 || h.scale == 0)
+        return false;
+    info.fps = double(h.rate) / h.scale;
+
+    scanned = false;
+    if (h.length > 0)
+        info.frames = h.length;
+    else if (h.odmlFrames > 0)
+        info.frames = h.odmlFrames;
+    else if (indexOffset >= 0 && readAt(file, indexOffset, indexSize, buffer)) {
+        info.frames = countIndexed(buffer, h.videoStream);
+        scanned = true;
+    } else
+        info.frames = h.totalFrames;
+    info.duration = info.frames / info.fps;
+    return info.frames > 0;
+}
+
+// what the boxes of the video track of an MP4 file tell
+struct Mp4Track {
+    Mp4Track() : video(false), timescale(0), duration(0), samples(0) {}
+    bool video;
+    unsigned int timescale;
+    unsigned long long duration;
+    unsigned int samples;
+};
+
+// walk the boxes of a moov box, filling track with the first video track
+static void parseMp4Boxes(const unsigned char *p, size_t n, Mp4Track &track, Mp4Track &current)
+{
+    size_t pos = 0;
+    while (pos + 8 <= n) {
+        const unsigned char *box = p + pos;
+        unsigned long long size = be32(box);
+        size_t header = 8;
+        if (size == 1 && pos + 16 <= n) {
+            size = be64(box + 8);
+            header = 16;
+        } else if (size == 0) {
+            size = n - pos;
+        }
+        if (size < header || size > n - pos)
+            break;
+        const unsigned char *data = box + header;
+        size_t bytes = size - header;
+
+        if (isTag(box + 4, "trak")) {
+            current = Mp4Track();
+            parseMp4Boxes(data, bytes, track, current);
+            if (current.video && !track.video)
+                track = current;
+        } else if (isTag(box + 4, "mdia") || isTag(box + 4, "minf") ||
+                   isTag(box + 4, "stbl")) {
+            parseMp4Boxes(data, bytes, track, current);
+        } else if (isTag(box + 4, "hdlr") && bytes >= 12) {
+            current.video = isTag(data + 8, "vide");
+        } else if (isTag(box + 4, "mdhd") && bytes >= 20) {
+            if (data[0] == 1 && bytes >= 32) {
+                current.timescale = be32(data + 20);
+                current.duration = be64(data + 24);
+            } else {
+                current.timescale = be32(data + 12);
+                current.duration = be32(data + 16);
+            }
+        } else if ((isTag(box + 4, "stsz") || isTag(box + 4, "stz2")) && bytes >= 12) {
+            current.samples = be32(data + 8);
+        }
+        pos += size;
+    }
+}
+
+/**
+ * probeMp4	-	probe an MP4/MOV file from its sample tables
+ *
+ * @return false if not an MP4/MOV file or it has no usable tables,
+ *         e.g. a fragmented one
+ */
+static bool probeMp4(FILE *file, VideoInfo &info)
+{
+    std::vector<unsigned char> box;
+    long long pos = 0;
+    // top-level boxes, moov may come after the media data
+    while (readAt(file, pos, 16, box) || readAt(file, pos, 8, box)) {
+        unsigned long long size = be32(&box[0]);
+        if (size == 1 && box.size() >= 16)
+            size = be64(&box[8]);
+        if (size < 8)
+            return false;
+        if (pos == 0 && !isTag(&box[4], "ftyp") && !isTag(&box[4], "moov") &&
+                !isTag(&box[4], "mdat") && !isTag(&box[4], "wide") &&
+                !isTag(&box[4], "free"))
+            return false;
+        if (isTag(&box[4], "moov")) {
+            std::vector<unsigned char> moov;
+            if (!readAt(file, pos, size, moov))
+                return false;
+            Mp4Track track, current;
+            parseMp4Boxes(moov.data() + 8, moov.size() - 8, track, current);
+            if (!track.video || track.samples == 0 || track.timescale == 0 ||
+                    track.duration == 0)
+                return false;
+            info.frames = track.samples;
+            info.duration = double(track.duration) / track.timescale;
+            info.fps = info.frames / info.duration;
+            return true;
+        }
+        pos += size;
+    }
+    return false;
+}
+
+/**
+ * probeDecode	-	count the frames of any video by decoding it
+ *
+ */
+static bool probeDecode(const std::string &fileName, VideoInfo &info)
+{
+    cv::VideoCapture capture(fileName);
+    if (!capture.isOpened())
+        return false;
+    info.fps = capture.get(CV_CAP_PROP_FPS);
+    info.frames = 0;
+    while (capture.grab())
+        ++info.frames;
+    info.duration = info.fps > 0 ? info.frames / info.fps : 0;
+    return info.frames > 0;
+}
+
+// name of the sidecar of a video
+static std::string sidecarName(const std::string &fileName)
+{
+    return fileName + ".probe";
+}
+
+static bool readSidecar(const std::string &fileName, const struct stat &st, VideoInfo &info)
+{
+    FILE *file = fopen(sidecarName(fileName).c_str(), "r");
+    if (!file)
+        return false;
+    int version = 0;
+    long long size = 0, mtime = 0;
+    int n = fscanf(file, "evmprobe %d %lld %lld %ld %lf %lf", &version, &size, &mtime,
+                   &info.frames, &info.fps, &info.duration);
+    fclose(file);
+    return n == 6 && version == SIDECAR_VERSION && size == (long long)st.st_size &&
+            mtime == (long long)st.st_mtime && info.frames > 0;
+}
+
+static void writeSidecar(const std::string &fileName, const struct stat &st, const VideoInfo &info)
+{
+    // a read-only directory only costs another scan next time
+    FILE *file = fopen(sidecarName(fileName).c_str(), "w");
+    if (!file)
+        return;
+    fprintf(file, "evmprobe %d %lld %lld %ld %.17g %.17g\n", SIDECAR_VERSION,
+            (long long)st.st_size, (long long)st.st_mtime,
+            info.frames, info.fps, info.duration);
+    fclose(file);
+}
+
+/**
+ * probeVideo	-	get the frame count, rate and duration of a video
+ *
+ * The headers of AVI and MP4/MOV files are read directly, which
+ * takes a few reads even on large files. What needs a scan, an AVI
+ * index or decoding a whole file in another container, is kept in
+ * a sidecar until the file changes.
+ *
+ * @param fileName	-	the video file
+ * @param info      -	what is found
+ *
+ * @return True if success. False otherwise
+ */
+bool probeVideo(const std::string &fileName, VideoInfo &info)
+{
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0)
+        return false;
+    if (readSidecar(fileName, st, info))
+        return true;
+
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (!file)
+        return false;
+    bool scanned = false;
+    bool found = probeAvi(file, info, scanned) || probeMp4(file, info);
+    fclose(file);
+
+    if (!found) {
+        found = probeDecode(fileName, info);
+        scanned = true;
+    }
+    if (found && scanned)
+        writeSidecar(fileName, st, info);
+    return found;
+}
@@ -1,33 +1,42 @@
-// Yet anther C++ implementation of EVM, based on OpenCV and Qt. 
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
 // Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
-// 
+//
 // This library is free software; you can redistribute it and/or modify
 // it under the terms of the GNU Lesser General Public License as
 // published by the Free Software Foundation; either version 2.1 of the
 // License, or (at your option) any later version.
-// 
+//
 // This library is distributed in the hope that it will be useful, but
 // WITHOUT ANY WARRANTY; without even the implied warranty of
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
 // Lesser General Public License for more details.
-// 
+//
 // You should have received a copy of the GNU Lesser General Public
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 // 02110-1301 USA
-// 
+//
 
-#ifndef WINDOWHELPER_H
-#define WINDOWHELPER_H
+#ifndef VIDEOPROBE_H
+#define VIDEOPROBE_H
 
-#include <QTime>
-#include <QCoreApplication>
+#include <string>
 
-class WindowHelper
-{
-public:
-    WindowHelper();
-    void sleep(int msecs);
+// what probeVideo() finds out about a video
+struct VideoInfo {
+    // exact number of frames
+    long frames;
+    // frames per second
+    double fps;
+    // length in seconds
+    double duration;
 };
 
-#endif // WINDOWHELPER_H
+// get the frame count, the frame rate and the duration of a video
+// from the headers or the index of an AVI or MP4/MOV container,
+// without decoding. Other files are decoded once, and what a scan
+// finds is kept in a <fileName>.probe sidecar keyed by the size and
+// the modification time of the file.
+bool probeVideo(const std::string &fileName, VideoInfo &info);
+
+#endif // VIDEOPROBE_H
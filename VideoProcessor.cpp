@@ -20,6 +20,178 @@
 
 #include "VideoProcessor.h"
 
+// a row strip of a pyramid level
+struct LevelStrip {
+    LevelStrip(int l, const cv::Range &r) : level(l), rows(r) {}
+    int level;
+    cv::Range rows;
+};
+
+// number of pixels in a strip of a pyramid level
+static const int STRIP_PIXELS = 64 * 1024;
+
+// frames decoded behind the playhead at once when stepping back,
+// so the following steps are served from the frame cache
+static const long SEEK_BLOCK = 16;
+
+// default budget of the frame cache
+static const size_t FRAME_CACHE_BYTES = 256 * 1024 * 1024;
+
+// lower case extension of a file name, with the dot
+static std::string fileExtension(const std::string &fileName)
+{
+    size_t dot = fileName.find_last_of("./\\");
+    if (dot == std::string::npos || fileName[dot] != '.')
+        return std::string();
+    std::string ext = fileName.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+// copy a file byte for byte
+static bool copyFile(const std::string &from, const std::string &to)
+{
+    FILE *src = fopen(from.c_str(), "rb");
+    if (!src)
+        return false;
+    FILE *dst = fopen(to.c_str(), "wb");
+    if (!dst) {
+        fclose(src);
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    bool ok = true;
+    size_t n;
+    while (ok && (n = fread(buffer.data(), 1, buffer.size(), src)) > 0)
+        ok = fwrite(buffer.data(), 1, n, dst) == n;
+    ok = ok && !ferror(src);
+    fclose(src);
+    ok = fclose(dst) == 0 && ok;
+    return ok;
+}
+
+// a tile of a frame with its own pyramid and IIR state
+struct MotionTile {
+    PyramidTile geometry;
+    std::vector<cv::Mat> pyramid;
+    std::vector<cv::Mat> filtered;
+    std::vector<cv::Mat> lowpassHi;
+    std::vector<cv::Mat> lowpassLo;
+    PyramidWorkspace workspace;
+    cv::Mat motion;
+};
+
+/**
+ * LevelFilter	-	temporal filtering and amplification
+ *                  of row strips of pyramid levels
+ *
+ * Every strip carries its own slice of the IIR state,
+ * so the strips can be processed in any order.
+ */
+class VideoProcessor::LevelFilter : public cv::ParallelLoopBody {
+public:
+    LevelFilter(VideoProcessor *processor,
+                const std::vector<cv::Mat> &pyramid,
+                std::vector<cv::Mat> &filtered,
+                const std::vector<float> &factors,
+                const std::vector<LevelStrip> &strips)
+        : processor(processor)
+        , pyramid(pyramid)
+        , filtered(filtered)
+        , factors(factors)
+        , strips(strips)
+    {
+    }
+
+    void operator()(const cv::Range &range) const
+    {
+        for (int i = range.start; i < range.end; ++i) {
+            int l = strips[i].level;
+            const cv::Range &rows = strips[i].rows;
+            cv::Mat dst = filtered[l].rowRange(rows.start, rows.end);
+            cv::Mat lowpassHi = processor->lowpass1[l].rowRange(rows.start, rows.end);
+            cv::Mat lowpassLo = processor->lowpass2[l].rowRange(rows.start, rows.end);
+            // filter and amplify in a single pass
+            processor->temporalIIRFilter(pyramid[l].rowRange(rows.start, rows.end),
+                                         dst, lowpassHi, lowpassLo, factors[l]);
+        }
+    }
+
+private:
+    VideoProcessor *processor;
+    const std::vector<cv::Mat> &pyramid;
+    std::vector<cv::Mat> &filtered;
+    const std::vector<float> &factors;
+    const std::vector<LevelStrip> &strips;
+};
+
+/**
+ * TileFilter	-	motion magnification of the tiles of a frame
+ *
+ * Every tile goes through its own pyramid, IIR filter, amplification
+ * and reconstruction, then only its core is copied to the motion
+ * image, so the tiles never write the same pixels.
+ */
+class VideoProcessor::TileFilter : public cv::ParallelLoopBody {
+public:
+    TileFilter(VideoProcessor *processor,
+               const cv::Mat &frame,
+               cv::Mat &motion,
+               std::vector<MotionTile> &tiles,
+               const std::vector<float> &factors,
+               bool first)
+        : processor(processor)
+        , frame(frame)
+        , motion(motion)
+        , tiles(tiles)
+        , factors(factors)
+        , first(first)
+    {
+    }
+
+    void operator()(const cv::Range &range) const
+    {
+        int levels = processor->levels;
+        for (int i = range.start; i < range.end; ++i) {
+            MotionTile &tile = tiles[i];
+            buildLaplacianPyramid(frame(tile.geometry.area), levels,
+                                  tile.pyramid, tile.workspace);
+            if (first) {
+                // the same initial state as the untiled path,
+                // level 0 and the top level stay zero
+                tile.lowpassHi.resize(levels);
+                tile.lowpassLo.resize(levels);
+                tile.filtered.resize(levels+1);
+                for (int l=0; l<=levels; ++l)
+                    tile.filtered[l] = cv::Mat::zeros(tile.pyramid[l].size(), tile.pyramid[l].type());
+                for (int l=1; l<levels; ++l) {
+                    packImage(tile.pyramid[l], tile.lowpassHi[l], processor->precision);
+                    packImage(tile.pyramid[l], tile.lowpassLo[l], processor->precision);
+                }
+            } else {
+                for (int l=1; l<levels; ++l)
+                    processor->temporalIIRFilter(tile.pyramid[l], tile.filtered[l],
+                                                 tile.lowpassHi[l], tile.lowpassLo[l],
+                                                 factors[l]);
+            }
+            reconImgFromLaplacianPyramid(tile.filtered, levels, tile.motion, tile.workspace);
+            processor->attenuate(tile.motion, tile.motion);
+
+            cv::Rect core = tile.geometry.core - tile.geometry.area.tl();
+            cv::Mat dst = motion(tile.geometry.core);
+            tile.motion(core).copyTo(dst);
+        }
+    }
+
+private:
+    VideoProcessor *processor;
+    const cv::Mat &frame;
+    cv::Mat &motion;
+    std::vector<MotionTile> &tiles;
+    const std::vector<float> &factors;
+    bool first;
+};
+
 VideoProcessor::VideoProcessor(QObject *parent)
   : QObject(parent)
   , delay(-1)
@@ -30,7 +202,6 @@ VideoProcessor::VideoProcessor(QObject *parent)
   , modify(false)
   , curPos(0)
   , curIndex(0)
-  , curLevel(0)
   , digits(0)
   , extension(".avi")
   , levels(4)
@@ -42,8 +213,57 @@ VideoProcessor::VideoProcessor(QObject *parent)
   , delta(0)
   , exaggeration_factor(2.0)
   , lambda(0)
+  , motionFilter(LAPLACIAN)
+  , colorFilter(IDEAL)
+  , filterOrder(2)
+  , streaming(false)
+  , streamWindow(0)
+  , pipelineDepth(8)
+  , playbackBuffer(8)
+  , tileSize(0)
+  , precision(FULL_PRECISION)
+  , memoryLimit(0)
+  , scratchDir(QDir::tempPath().toStdString())
+  , profiler(new StageProfiler)
+  , shownFrames(0)
+  , droppedFrames(0)
+  , playbackFps(0)
+  , frameCache(FRAME_CACHE_BYTES)
+  , seekTarget(-1)
+  , seekBusy(false)
+  , seekQuit(false)
+  , resumeAfterSeek(false)
+  , progressFrames(0)
+  , progressStage(0)
+  , progressStart(0)
+  , outputCodec(0)
+  , outputRate(0)
+  , directCodec(0)
+  , losslessTemp(true)
+  , renderModified(false)
+  , bandCaching(false)
 {
+    decodeStats = encodeStats = QueueStats();
+    // frames are shown from the player thread
+    qRegisterMetaType<cv::Mat>("cv::Mat");
+    // cancelIt() stops the ideal filter between blocks of rows
+    temporalFFT.setCancelFlag(&stop);
     connect(this, SIGNAL(revert()), this, SLOT(revertVideo()));
+    connect(this, SIGNAL(seeked()), this, SLOT(resumePlayback()));
+}
+
+VideoProcessor::~VideoProcessor()
+{
+    stopPlayback();
+
+    if (seeker.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(seekLock);
+            seekQuit = true;
+        }
+        seekWake.notify_one();
+        seeker.join();
+    }
 }
 
 /** 
@@ -113,6 +333,10 @@ long VideoProcessor::getFrameNumber()
  */
 double VideoProcessor::getPositionMS()
 {
+    // the capture is ahead of the shown frame when playing or stepping
+    if (rate > 0)
+        return 1000.0 * curPos / rate;
+
     double t = capture.get(CV_CAP_PROP_POS_MSEC);
 
     return t;
@@ -126,6 +350,10 @@ double VideoProcessor::getPositionMS()
  */
 double VideoProcessor::getFrameRate()
 {
+    // the capture may belong to the player or the seeker meanwhile
+    if (rate > 0)
+        return rate;
+
     double r = capture.get(CV_CAP_PROP_FPS);
 
     return r;
@@ -155,26 +383,29 @@ double VideoProcessor::getLengthMS()
 }
 
 /** 
- * calculateLength	-	recalculate the number of frames in video
+ * calculateLength	-	get the exact number of frames and frame rate
  * 
- * normally doesn't need it unless getLength()
- * can't return a valid value
+ * From the container when possible, see probeVideo().
  */
 void VideoProcessor::calculateLength()
 {
-    long l = 0;
-    cv::Mat img;
-    cv::VideoCapture tempCapture(tempFile);
-    while(tempCapture.read(img)){
-        ++l;
-    }
-    length = l;
-    tempCapture.release();
+    // frame stores are exact already
+    if (capture.isStore())
+        return;
+    VideoInfo info;
+    if (!probeVideo(tempFile, info))
+        return;
+    length = info.frames;
+    if (info.fps > 0)
+        rate = info.fps;
 }
 
 /** 
  * spatialFilter	-	spatial filtering an image
  *
+ * The levels are written into reused buffers, so they are
+ * only valid until the next call.
+ *
  * @param src		-	source image 
  * @param pyramid	-	destinate pyramid
  */
@@ -182,7 +413,8 @@ bool VideoProcessor::spatialFilter(const cv::Mat &src, std::vector<cv::Mat> &pyr
 {
     switch (spatialType) {
     case LAPLACIAN:     // laplacian pyramid
-        return buildLaplacianPyramid(src, levels, pyramid);
+    case RIESZ:         // built on the laplacian pyramid
+        return buildLaplacianPyramid(src, levels, pyramid, workspace);
         break;
     case GAUSSIAN:      // gaussian pyramid
         return buildGaussianPyramid(src, levels, pyramid);
@@ -196,6 +428,9 @@ bool VideoProcessor::spatialFilter(const cv::Mat &src, std::vector<cv::Mat> &pyr
 /** 
  * temporalFilter	-	temporal filtering an image
  *
+ * IIR filtering keeps a state per pyramid level,
+ * so it is called through temporalIIRFilter() instead.
+ *
  * @param src	-	source image
  * @param dst	-	destinate image
  */
@@ -203,9 +438,6 @@ void VideoProcessor::temporalFilter(const cv::Mat &src,
                                     cv::Mat &dst)
 {
     switch(temporalType) {
-    case IIR:       // IIR bandpass filter
-        temporalIIRFilter(src, dst);
-        break;
     case IDEAL:     // Ideal bandpass filter
         temporalIdealFilter(src, dst);
         break;
@@ -218,18 +450,25 @@ void VideoProcessor::temporalFilter(const cv::Mat &src,
 /** 
  * temporalIIRFilter	-	temporal IIR filtering an image
  *                          (thanks to Yusuke Tomoto)
- * @param pyramid	-	source image
- * @param filtered	-	filtered result
  *
+ * All the Mats may be ROIs of larger images, the results are
+ * written in place so that strips of a level can be filtered
+ * concurrently. Both states and the band are updated in one
+ * fused pass (see iirBandpass).
+ *
+ * @param src       -	source image
+ * @param dst       -	filtered result
+ * @param lowpassHi	-	state of the low pass filter at fh
+ * @param lowpassLo	-	state of the low pass filter at fl
+ * @param gain      -	amplification applied to the result
  */
 void VideoProcessor::temporalIIRFilter(const cv::Mat &src,
-                                    cv::Mat &dst)
+                                       cv::Mat &dst,
+                                       cv::Mat &lowpassHi,
+                                       cv::Mat &lowpassLo,
+                                       float gain)
 {
-    cv::Mat temp1 = (1-fh)*lowpass1[curLevel] + fh*src;
-    cv::Mat temp2 = (1-fl)*lowpass2[curLevel] + fl*src;
-    lowpass1[curLevel] = temp1;
-    lowpass2[curLevel] = temp2;
-    dst = lowpass1[curLevel] - lowpass2[curLevel];
+    iirBandpass(src, lowpassHi, lowpassLo, dst, fl, fh, gain);
 }
 
 /** 
@@ -243,70 +482,90 @@ void VideoProcessor::temporalIIRFilter(const cv::Mat &src,
 void VideoProcessor::temporalIdealFilter(const cv::Mat &src,
                                           cv::Mat &dst)
 {
-    cv::Mat channels[3];
-
-    // split into 3 channels
-    cv::split(src, channels);
-
-    for (int i = 0; i < 3; ++i){
-
-        cv::Mat current = channels[i];  // current channel
-        cv::Mat tempImg;
-
-        int width = cv::getOptimalDFTSize(current.cols);
-        int height = cv::getOptimalDFTSize(current.rows);
-
-        cv::copyMakeBorder(current, tempImg,
-                           0, height - current.rows,
-                           0, width - current.cols,
-                           cv::BORDER_CONSTANT, cv::Scalar::all(0));
-
-        // do the DFT
-        cv::dft(tempImg, tempImg, cv::DFT_ROWS | cv::DFT_SCALE);
-
-        // construct the filter
-        cv::Mat filter = tempImg.clone();
-        createIdealBandpassFilter(filter, fl, fh, rate);
-
-        // apply filter
-        cv::mulSpectrums(tempImg, filter, tempImg, cv::DFT_ROWS);
-
-        // do the inverse DFT on filtered image
-        cv::idft(tempImg, tempImg, cv::DFT_ROWS | cv::DFT_SCALE);
-
-        // copy back to the current channel
-        tempImg(cv::Rect(0, 0, current.cols, current.rows)).copyTo(channels[i]);
-    }
-    // merge channels
-    cv::merge(channels, 3, dst);
+    idealBandpass(src, dst);
 
     // normalize the filtered image
     cv::normalize(dst, dst, 0, 1, CV_MINMAX);
 }
 
+/**
+ * idealBandpass	-	ideal bandpass filtering of concat-frames
+ *                      without normalizing the result
+ *
+ * The output keeps the amplitude of the passed band, so that
+ * filtered windows of a stream stay comparable to each other.
+ *
+ * @param src	-	source concatenate frames
+ * @param dst	-	concatenate filtered result
+ */
+void VideoProcessor::idealBandpass(const cv::Mat &src,
+                                   cv::Mat &dst)
+{
+    temporalFFT.idealBandpass(src, dst, fl, fh, rate);
+}
+
 /** 
  * amplify	-	ampilfy the motion
  *
- * @param filtered	- motion image
+ * @param src       -	motion image
+ * @param dst       -	amplified image, may be src itself
+ * @param factor	-	amplification factor
  */
-void VideoProcessor::amplify(const cv::Mat &src, cv::Mat &dst)
+void VideoProcessor::amplify(const cv::Mat &src, cv::Mat &dst, float factor)
 {
-    float currAlpha;    
-    switch (spatialType) {
-    case LAPLACIAN:        
-        //compute modified alpha for this level
-        currAlpha = lambda/delta/8 - 1;
-        currAlpha *= exaggeration_factor;
-        if (curLevel==levels || curLevel==0)     // ignore the highest and lowest frequency band
-            dst = src * 0;
-        else
-            dst = src * cv::min(alpha, currAlpha);
-        break;
-    case GAUSSIAN:
-        dst = src * alpha;
-        break;
-    default:
-        break;
+    src.convertTo(dst, -1, factor);
+}
+
+/**
+ * bandAmplification	-	amplification factor of a laplacian pyramid level
+ *
+ * @param level     -	pyramid level
+ * @param lambda	-	representative wavelength of the level
+ *
+ * @return the amplification factor
+ */
+float VideoProcessor::bandAmplification(int level, float lambda)
+{
+    // ignore the highest and lowest frequency band
+    if (level==levels || level==0)
+        return 0;
+
+    //compute modified alpha for this level
+    float currAlpha = lambda/delta/8 - 1;
+    currAlpha *= exaggeration_factor;
+    return cv::min(alpha, currAlpha);
+}
+
+/**
+ * bandFactors	-	amplification factors of all the laplacian pyramid levels
+ *
+ * Also sets delta, exaggeration_factor and lambda, following
+ * Figure 6 of the paper.
+ *
+ * @param frameSize	-	size of the whole frame
+ * @param factors	-	destinate factors, levels+1 of them
+ */
+void VideoProcessor::bandFactors(const cv::Size &frameSize, std::vector<float> &factors)
+{
+    int w = frameSize.width;
+    int h = frameSize.height;
+
+    delta = lambda_c/8.0/(1.0+alpha);
+    // the factor to boost alpha above the bound
+    // (for better visualization)
+    exaggeration_factor = 2.0;
+
+    // compute the representative wavelength lambda
+    // for the lowest spatial frequency band of Laplacian pyramid
+    lambda = sqrt(w*w + h*h)/3;  // 3 is experimental constant
+
+    factors.assign(levels+1, 0.0f);
+    for (int i=levels; i>=0; i--) {
+        factors[i] = bandAmplification(i, lambda);
+
+        // go one level down on pyramid
+        // representative lambda will reduce by factor of 2
+        lambda /= 2.0;
     }
 }
 
@@ -318,17 +577,14 @@ void VideoProcessor::amplify(const cv::Mat &src, cv::Mat &dst)
  */
 void VideoProcessor::attenuate(cv::Mat &src, cv::Mat &dst)
 {
-    cv::Mat planes[3];
-    cv::split(src, planes);
-    planes[1] = planes[1] * chromAttenuation;
-    planes[2] = planes[2] * chromAttenuation;
-    cv::merge(planes, 3, dst);
+    cv::multiply(src, cv::Scalar(1, chromAttenuation, chromAttenuation), dst);
 }
 
 
 /** 
  * concat	-	concat all the frames into a single large Mat
- *              where each column is a reshaped single frame
+ *              where each row is the time series of one pixel
+ *              (see TimeSeriesBuffer)
  *
  * @param frames	-	frames of the video sequence
  * @param dst		-	destinate concatnate image
@@ -336,66 +592,135 @@ void VideoProcessor::attenuate(cv::Mat &src, cv::Mat &dst)
 void VideoProcessor::concat(const std::vector<cv::Mat> &frames,
                             cv::Mat &dst)
 {
-    cv::Size frameSize = frames.at(0).size();
-    cv::Mat temp(frameSize.width*frameSize.height, length-1, CV_32FC3);
-    for (int i = 0; i < length-1; ++i) {
-        // get a frame if any
-        cv::Mat input = frames.at(i);
-        // reshape the frame into one column
-        cv::Mat reshaped = input.reshape(3, input.cols*input.rows).clone();
-        cv::Mat line = temp.col(i);
-        // save the reshaped frame to one column of the destinate big image
-        reshaped.copyTo(line);
-    }
-    temp.copyTo(dst);
+    TimeSeriesBuffer buffer;
+    buffer.create(frames.at(0).size(), frames.at(0).type(), frames.size());
+    for (size_t i = 0; i < frames.size(); ++i)
+        buffer.push(frames[i]);
+    dst = buffer.series();
 }
 
 /**
  * deConcat	-	de-concat the concatnate image into frames
  *
+ * The frames are views of a single frame-major buffer.
+ *
  * @param src       -   source concatnate image
  * @param framesize	-	frame size
  * @param frames	-	destinate frames
+ * @param storage	-	preallocated frame-major buffer, optional
  */
 void VideoProcessor::deConcat(const cv::Mat &src,
                               const cv::Size &frameSize,
-                              std::vector<cv::Mat> &frames)
+                              std::vector<cv::Mat> &frames,
+                              cv::Mat storage)
 {
-    for (int i = 0; i < length-1; ++i) {    // get a line if any
-        cv::Mat line = src.col(i).clone();
-        cv::Mat reshaped = line.reshape(3, frameSize.height).clone();
-        frames.push_back(reshaped);
-    }
+    seriesToFrames(src, frameSize, frames, storage);
 }
 
 /**
- * createIdealBandpassFilter	-	create a 1D ideal band-pass filter
+ * effectiveMemoryLimit	-	the memory limit in bytes
  *
- * @param filter    -	destinate filter
- * @param fl        -	low cut-off
- * @param fh		-	high cut-off
- * @param rate      -   sampling rate(i.e. video frame rate)
+ * @return the limit, half of the physical memory unless set,
+ *         0 if unknown
  */
-void VideoProcessor::createIdealBandpassFilter(cv::Mat &filter, double fl, double fh, double rate)
+size_t VideoProcessor::effectiveMemoryLimit()
 {
-    int width = filter.cols;
-    int height = filter.rows;
+    return memoryLimit ? memoryLimit : ScratchFile::physicalMemory() / 2;
+}
 
-    fl = 2 * fl * width / rate;
-    fh = 2 * fh * width / rate;
+/**
+ * exceedsMemoryLimit	-	does a working set exceed the memory limit
+ *
+ * @param bytes	-	size of the working set
+ *
+ * @return true if it should be spilled to scratch files
+ */
+bool VideoProcessor::exceedsMemoryLimit(size_t bytes)
+{
+    size_t limit = effectiveMemoryLimit();
+    return limit > 0 && bytes > limit;
+}
 
-    double response;
+/**
+ * renderSource	-	the video a magnification starts from
+ *
+ * If the current video is the result of the last magnification and
+ * the bandpassed levels of its source are cached, the source is
+ * reopened, so that running again with other gains re-renders the
+ * source instead of magnifying the result once more. Otherwise the
+ * current video is magnified, see getSourceFile().
+ *
+ * @param color	-	for color magnification, motion otherwise
+ *
+ * @return the file name of the video to magnify
+ */
+std::string VideoProcessor::renderSource(bool color)
+{
+    // gone back to if the run is cancelled
+    renderInput = tempFile;
+    renderModified = modify;
+
+    std::string source = getSourceFile(color);
+    if (source != tempFile)
+        setInput(source);
+    return tempFile;
+}
 
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            // filter response
-            if (j >= fl && j <= fh)
-                response = 1.0f;
-            else
-                response = 0.0f;
-            filter.at<float>(i, j) = response;
-        }
+/**
+ * finishRender	-	make the processed video the video, or drop it
+ *
+ * A cancelled run leaves the video as it was: its partial temp file
+ * is deleted and the video before the run is reopened if the run
+ * started from another one.
+ *
+ * @param source	-	the video the run started from
+ * @param keep      -	false if the run was cancelled or failed
+ */
+void VideoProcessor::finishRender(const std::string &source, bool keep)
+{
+    // done or cancelled, the processor is stopped either way
+    stop = true;
+
+    // release the temp writer
+    tempWriter.release();
+
+    if (keep) {
+        setInput(tempFile);
+        lastRender = tempFile;
+        lastRenderSource = source;
+        return;
     }
+
+    remove(tempFile.c_str());
+    if (!tempFileList.empty() && tempFileList.back() == tempFile)
+        tempFileList.pop_back();
+    // the capture still reads the source
+    tempFile = source;
+    if (renderInput != source)
+        setInput(renderInput);
+    modify = renderModified;
+}
+
+/**
+ * composeColorFrame	-	add an up-sampled color motion to a frame
+ *
+ * @param frame     -	source frame (CV_32FC3)
+ * @param motion	-	amplified motion on the coarse pyramid level
+ * @param output	-	destinate CV_8UC3 frame
+ */
+void VideoProcessor::composeColorFrame(const cv::Mat &frame,
+                                       const cv::Mat &motion,
+                                       cv::Mat &output)
+{
+    cv::Mat up;
+    // up-sample the motion image
+    upsamplingFromGaussianPyramid(motion, levels, up);
+    resize(up, up, frame.size());
+    cv::Mat temp = frame + up;
+    double minVal, maxVal;
+    minMaxLoc(temp, &minVal, &maxVal); //find minimum and maximum intensities
+    temp.convertTo(output, CV_8UC3, 255.0/(maxVal - minVal),
+                   -minVal * 255.0/(maxVal - minVal));
 }
 
 /** 
@@ -447,6 +772,33 @@ void VideoProcessor::getCurTempFile(std::string &str)
     str = tempFile;
 }
 
+/**
+ * getSourceFile	-	the video a magnification would start from
+ *
+ * @param color	-	for color magnification, motion otherwise
+ *
+ * @return the source of the current video if it is the result of
+ *         the last magnification and the bands of the source can be
+ *         re-used, the current video otherwise, so that the
+ *         magnifications stack
+ */
+std::string VideoProcessor::getSourceFile(bool color)
+{
+    if (!bandCaching || lastRender.empty() || tempFile != lastRender
+            || lastRenderSource.empty())
+        return tempFile;
+
+    // only these runs use the band cache
+    int filter = -1;
+    if (color && colorFilter == IDEAL && !streaming)
+        filter = IDEAL;
+    else if (!color && motionFilter != RIESZ)
+        filter = IIR;
+    // a result has the frames of its source
+    BandCacheKey key(lastRenderSource, levels, fl, fh, filter, precision, length);
+    return bandCache.matches(key) ? lastRenderSource : tempFile;
+}
+
 /** 
  * setInput	-	set the name of the expected video file
  *
@@ -456,6 +808,9 @@ void VideoProcessor::getCurTempFile(std::string &str)
  */
 bool VideoProcessor::setInput(const std::string &fileName)
 {
+    stopPlayback();
+    frameCache.clear();
+
     fnumber = 0;
     tempFile = fileName;
 
@@ -467,12 +822,15 @@ bool VideoProcessor::setInput(const std::string &fileName)
 
     // Open the video file
     if(capture.open(fileName)){
-        // read parameters
+        // read parameters, CV_CAP_PROP_FRAME_COUNT is only an
+        // estimate for many containers
         length = capture.get(CV_CAP_PROP_FRAME_COUNT);
-        rate = getFrameRate();
+        rate = capture.get(CV_CAP_PROP_FPS);
+        calculateLength();
         cv::Mat input;
         // show first frame
         getNextFrame(input);
+        curPos = 1;
         emit showFrame(input);
         emit updateBtn();
         return true;
@@ -507,6 +865,9 @@ bool VideoProcessor::setOutput(const std::string &filename, int codec, double fr
         codec = getCodec(c);
     }
 
+    outputCodec = codec;
+    outputRate = framerate;
+
     // Open output video
     return writer.open(outputFile, // filename
                        codec, // codec to be used
@@ -545,10 +906,42 @@ bool VideoProcessor::setOutput(const std::string &filename, const std::string &e
     return true;
 }
 
+/**
+ * setDirectOutput	-	write the next magnification straight to a file
+ *
+ * The result is encoded once, while it is processed, and becomes
+ * the input as a temp file would. The file is not a temp file, so
+ * it is kept, and writeOutput() is not needed.
+ *
+ * @param filename	-	the output video file
+ * @param codec     -	video codec, 0 for MJPG
+ */
+void VideoProcessor::setDirectOutput(const std::string &filename, int codec)
+{
+    directFile = filename;
+    directCodec = codec;
+}
+
+/**
+ * setLosslessTemp	-	choose the format of the temp files
+ *
+ * Frame stores are not re-encoded between magnifications, and seek
+ * without decoding, so they are the default. Without LZ4 they hold
+ * raw frames, about 6MB a frame at 1080p; MJPG videos take far less
+ * disk but lose detail at every magnification.
+ *
+ * @param lossless	-	write frame stores
+ */
+void VideoProcessor::setLosslessTemp(bool lossless)
+{
+    losslessTemp = lossless;
+}
+
 /** 
  * setTemp	-	set the temp video file
  *
- * by default the same parameters to the input video
+ * by default the same parameters to the input video. Temp
+ * files may be frame stores, see setLosslessTemp().
  *
  * @param codec	-	video codec
  * @param framerate	-	frame rate
@@ -558,23 +951,88 @@ bool VideoProcessor::setOutput(const std::string &filename, const std::string &e
  */
 bool VideoProcessor::createTemp(double framerate, bool isColor)
 {
-    std::stringstream ss;
-    ss << "temp_" << QDateTime::currentDateTime().toTime_t() << ".avi";
-    tempFile = ss.str();
+    // jobs may run concurrently, so the name must be unique
+    // within the process as well as over time
+    static std::atomic<int> counter(0);
+    int codec = CV_FOURCC('M', 'J', 'P', 'G');
+    if (!directFile.empty()) {
+        // used once, so that the next magnification won't overwrite it
+        tempFile = directFile;
+        if (directCodec)
+            codec = directCodec;
+        directFile.clear();
+    } else {
+        std::stringstream ss;
+        ss << "temp_" << QDateTime::currentMSecsSinceEpoch()
+           << "_" << counter++ << (losslessTemp ? FRAME_STORE_EXT : ".avi");
+        tempFile = ss.str();
 
-    tempFileList.push_back(tempFile);
+        tempFileList.push_back(tempFile);
+    }
 
     if (framerate==0.0)
         framerate = getFrameRate(); // same as input
 
     // Open output video
     return tempWriter.open(tempFile, // filename
-                       CV_FOURCC('M', 'J', 'P', 'G'), // codec to be used
+                       codec,          // codec to be used
                        framerate,      // frame rate of the video
                        getFrameSize(), // frame size
                        isColor);       // color video?
 }
 
+/**
+ * setAlpha	-	set the amplification factor
+ *
+ * @param a	-	amplification factor
+ */
+void VideoProcessor::setAlpha(float a)
+{
+    alpha = a;
+}
+
+/**
+ * setLambdaC	-	set the cut-off spatial wavelength
+ *
+ * @param l	-	wavelength in pixels
+ */
+void VideoProcessor::setLambdaC(float l)
+{
+    lambda_c = l;
+}
+
+/**
+ * setCutoffs	-	set the cut-offs of the temporal filters
+ *
+ * @param low	-	low cut-off
+ * @param high	-	high cut-off
+ */
+void VideoProcessor::setCutoffs(float low, float high)
+{
+    fl = low;
+    fh = high;
+}
+
+/**
+ * setChromAttenuation	-	set the attenuation of the I, Q channels
+ *
+ * @param attenuation	-	attenuation factor
+ */
+void VideoProcessor::setChromAttenuation(float attenuation)
+{
+    chromAttenuation = attenuation;
+}
+
+/**
+ * setLevels	-	set the levels of the spatial pyramids
+ *
+ * @param l	-	number of levels, at least 1
+ */
+void VideoProcessor::setLevels(int l)
+{
+    levels = std::max(l, 1);
+}
+
 /** 
  * setSpatialFilter	-	set the spatial filter
  *
@@ -593,122 +1051,613 @@ void VideoProcessor::setSpatialFilter(spatialFilterType type)
  * @param type	-	temporal filter type. Could be:
  *					1. IIR: second order(IIR) filter
  *					2. IDEAL: ideal bandpass filter
+ *					3. BUTTERWORTH: causal Butterworth bandpass filter
  */
 void VideoProcessor::setTemporalFilter(temporalFilterType type)
 {
     temporalType = type;
 }
 
-/** 
- * stopIt	-	stop playing or processing
+/**
+ * setMotionFilter	-	set the pyramid of motion magnification
  *
+ * The laplacian pyramid amplifies the intensity changes linearly.
+ * The Riesz pyramid amplifies the local phase instead, which moves
+ * the structures and doesn't amplify the noise with them, so it
+ * bears larger amplifications.
+ *
+ * @param type	-	LAPLACIAN or RIESZ
  */
-void VideoProcessor::stopIt()
+void VideoProcessor::setMotionFilter(spatialFilterType type)
 {
-    stop = true;
-    emit revert();
+    motionFilter = (type == RIESZ) ? RIESZ : LAPLACIAN;
 }
 
-/** 
- * prevFrame	-	display the prev frame of the sequence
+/**
+ * setColorFilter	-	set the temporal filter of color magnification
+ *
+ * The ideal filter needs the whole video (or a window of it in
+ * streaming mode). The Butterworth filter is causal: frames are
+ * filtered and written as they are decoded, in constant memory.
  *
+ * @param type	-	IDEAL or BUTTERWORTH
  */
-void VideoProcessor::prevFrame()
+void VideoProcessor::setColorFilter(temporalFilterType type)
 {
-    if(isStop())
-        pauseIt();
-    if (curPos >= 0){
-        curPos -= 1;
-        jumpTo(curPos);
-    }
-    emit updateProgressBar();
+    colorFilter = (type == BUTTERWORTH) ? BUTTERWORTH : IDEAL;
 }
 
-/** 
- * nextFrame	-	display the next frame of the sequence
+/**
+ * setFilterOrder	-	set the order of the Butterworth filter
  *
+ * @param order	-	order of the lowpass prototype, 1 to 8;
+ *                  the bandpass has twice as many poles
  */
-void VideoProcessor::nextFrame()
+void VideoProcessor::setFilterOrder(int order)
 {
-    if(isStop())
-        pauseIt();
-    curPos += 1;
-    if (curPos <= length){
-        curPos += 1;
-        jumpTo(curPos);
-    }
-    emit updateProgressBar();
+    filterOrder = std::min(std::max(order, 1), 8);
 }
 
-/** 
- * jumpTo	-	Jump to a position
+/**
+ * setStreaming	-	process color magnification in bounded sliding windows
  *
- * @param index	-	frame index
+ * In streaming mode only a window of coarse frames is kept in memory
+ * and output frames are written while the input is still decoded.
+ * The band is not normalized to [0, 1] as in the batch mode, since
+ * each window would get its own scale, so alpha amplifies the band
+ * as filtered and usually needs a different value for the same look.
  *
- * @return True if success. False otherwise
+ * @param s	-	true to enable the streaming mode
  */
-bool VideoProcessor::jumpTo(long index)
+void VideoProcessor::setStreaming(bool s)
 {
-    if (index >= length){
-        return 1;
-    }
-
-    cv::Mat frame;
-    bool re = capture.set(CV_CAP_PROP_POS_FRAMES, index);
-
-    if (re && !isStop()){
-        capture.read(frame);
-        emit showFrame(frame);
-    }
-
-    return re;
+    streaming = s;
 }
 
-
-/** 
- * jumpToMS	-	jump to a position at a time
- *
- * @param pos	-	time
- *
- * @return True if success. False otherwise
+/**
+ * setStreamWindow	-	set the sliding window length of the streaming mode
  *
+ * @param frames	-	window length in frames. 0 means choose one
+ *                      from the frame rate and the low cut-off
  */
-bool VideoProcessor::jumpToMS(double pos)
+void VideoProcessor::setStreamWindow(int frames)
 {
-    return capture.set(CV_CAP_PROP_POS_MSEC, pos);
+    streamWindow = frames;
 }
 
-
-/** 
- * close	-	close the video
+/**
+ * setPipelineDepth	-	set the capacity of the queues between pipeline stages
  *
+ * @param depth	-	number of frames each queue can hold
  */
-void VideoProcessor::close()
+void VideoProcessor::setPipelineDepth(int depth)
 {
-    rate = 0;
-    length = 0;
-    modify = 0;
-    capture.release();
-    writer.release();
-    tempWriter.release();
+    pipelineDepth = std::max(depth, 1);
 }
 
-
-/** 
- * isStop	-	Is the processing stop
+/**
+ * setPlaybackBuffer	-	set the number of frames decoded ahead during playback
  *
+ * Takes effect from the next playIt().
  *
- * @return True if not processing/playing. False otherwise
+ * @param frames	-	number of frames, at least 1
  */
-bool VideoProcessor::isStop()
+void VideoProcessor::setPlaybackBuffer(int frames)
 {
-    return stop;
+    playbackBuffer = std::max(frames, 1);
 }
 
-/** 
- * isModified	-	Is the video modified?
- *
- *
+/**
+ * setTileSize	-	set the tile size of motion magnification
+ *
+ * Tiled frames are magnified one tile per worker. Each tile is
+ * filtered with a halo around it, which is redundant work, and
+ * no gain over the untiled path has been measured yet, so frames
+ * are not tiled by default. The output matches the untiled path
+ * up to float rounding, i.e. at most one 8-bit level per pixel
+ * (see splitPyramidTiles).
+ *
+ * The automatic size is not fitted to the L2 cache, on purpose:
+ * the halo is 4 << levels pixels on each side, so at 4 levels a
+ * tile whose float Lab levels fit in 1 MB (about 290 pixels on a
+ * side) has a 160 pixel core and filters twice its own area as
+ * halo. The core is four halos wide instead, for at most 1.25
+ * times redundant work.
+ *
+ * @param size	-	width and height of a tile without its halo,
+ *                  0 not to tile, negative for a size chosen
+ *                  from the pyramid levels
+ */
+void VideoProcessor::setTileSize(int size)
+{
+    tileSize = size;
+}
+
+/**
+ * setPrecision	-	set the precision of the IIR states and the buffered frames
+ *
+ * Half floats and fixed-point values halve the memory and the memory
+ * traffic of the states of motion magnification and of the frames
+ * buffered by color magnification. The filtering itself still runs
+ * on floats; the benchmark reports the PSNR against FULL_PRECISION.
+ *
+ * @param p	-	FULL_PRECISION, HALF_PRECISION or FIXED_PRECISION
+ */
+void VideoProcessor::setPrecision(storagePrecision p)
+{
+    precision = p;
+}
+
+/**
+ * setMemoryLimit	-	set the memory ceiling of color magnification
+ *
+ * Beyond it the buffered frames and the time series are kept in
+ * memory-mapped scratch files instead of RAM.
+ *
+ * @param bytes	-	the ceiling, 0 for half of the physical memory
+ */
+void VideoProcessor::setMemoryLimit(size_t bytes)
+{
+    memoryLimit = bytes;
+}
+
+/**
+ * setScratchDir	-	set the directory of the scratch files
+ *
+ * @param dir	-	the directory, it should be on a local disk
+ */
+void VideoProcessor::setScratchDir(const std::string &dir)
+{
+    scratchDir = dir.empty() ? QDir::tempPath().toStdString() : dir;
+}
+
+/**
+ * setBandCaching	-	keep the bandpassed levels of a run
+ *
+ * Meant for tuning the gains of one video: the levels take
+ * several times the memory of the frames, and are spilled to a
+ * scratch file beyond the memory limit.
+ *
+ * @param enabled	-	true to record the levels
+ */
+void VideoProcessor::setBandCaching(bool enabled)
+{
+    bandCaching = enabled;
+    if (!enabled)
+        bandCache.clear();
+}
+
+/**
+ * getProfiler	-	the timings of the processing stages
+ *
+ * @return the profiler, call setEnabled(true) on it to record
+ */
+std::shared_ptr<StageProfiler> VideoProcessor::getProfiler()
+{
+    return profiler;
+}
+
+/**
+ * setProfiler	-	record the stage timings into another profiler
+ *
+ * Lets several processors share one timeline.
+ *
+ * @param p	-	the profiler
+ */
+void VideoProcessor::setProfiler(const std::shared_ptr<StageProfiler> &p)
+{
+    if (p)
+        profiler = p;
+}
+
+/**
+ * getDecodeQueueStats	-	statistics of the decoded frame queue
+ *
+ * @return the statistics of the last motion magnification
+ */
+QueueStats VideoProcessor::getDecodeQueueStats()
+{
+    return decodeStats;
+}
+
+/**
+ * getEncodeQueueStats	-	statistics of the to-be-encoded frame queue
+ *
+ * @return the statistics of the last motion magnification
+ */
+QueueStats VideoProcessor::getEncodeQueueStats()
+{
+    return encodeStats;
+}
+
+/**
+ * getPlaybackStats	-	statistics of the running or the last playback
+ *
+ * @return the achieved frame rate and the shown and skipped frames
+ */
+PlaybackStats VideoProcessor::getPlaybackStats()
+{
+    PlaybackStats s;
+    s.fps = playbackFps;
+    s.shown = shownFrames;
+    s.dropped = droppedFrames;
+    return s;
+}
+
+/** 
+ * stopIt	-	stop playing or processing
+ *
+ */
+void VideoProcessor::stopIt()
+{
+    stop = true;
+    emit revert();
+}
+
+/**
+ * cancelIt	-	cancel the processing from another thread
+ *
+ * Only raises the stop flag, the processing gives up at its next
+ * frame and leaves the video as it was.
+ */
+void VideoProcessor::cancelIt()
+{
+    stop = true;
+}
+
+/**
+ * clearCancel	-	clear the stop flag before a processing starts
+ *
+ * The magnify methods leave the flag alone, so that a cancelIt()
+ * raised while the run is being set up is not lost. The caller
+ * clears it before publishing the processor to whoever may cancel.
+ */
+void VideoProcessor::clearCancel()
+{
+    stop = false;
+}
+
+/**
+ * reportProgress	-	publish the progress of the processing
+ *
+ * Cheap enough for every frame, getProcessProgress() reads it.
+ * The clock restarts with each stage.
+ *
+ * @param stage	-	what is being done, a string literal
+ * @param frame	-	number of frames done in this stage
+ */
+void VideoProcessor::reportProgress(const char *stage, long frame)
+{
+    if (frame <= 1 || progressStage.load(std::memory_order_relaxed) != stage) {
+        progressStart = std::chrono::steady_clock::now().time_since_epoch().count();
+        progressStage = stage;
+    }
+    progressFrames.store(frame, std::memory_order_release);
+}
+
+/**
+ * getProcessProgress	-	progress of the running processing
+ *
+ * For polling from another thread.
+ *
+ * @return the stage, the percentage, the frame rate and the time left
+ */
+ProcessProgress VideoProcessor::getProcessProgress()
+{
+    typedef std::chrono::steady_clock clock;
+
+    ProcessProgress p;
+    p.frames = progressFrames.load(std::memory_order_acquire);
+    p.stage = progressStage;
+    long total = std::max(length, 1L);
+    p.percent = std::min(100.0 * p.frames / total, 100.0);
+
+    clock::duration elapsed = clock::now().time_since_epoch() -
+            clock::duration(progressStart.load());
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    p.fps = seconds > 0 ? p.frames / seconds : 0;
+    p.remaining = p.fps > 0 ? std::max(total - p.frames, 0L) / p.fps : -1;
+    return p;
+}
+
+/** 
+ * prevFrame	-	display the prev frame of the sequence
+ *
+ */
+void VideoProcessor::prevFrame()
+{
+    pauseIt();
+    // curPos is the frame after the shown one
+    if (curPos >= 2)
+        showFrameAt(curPos - 2);
+    emit updateProgressBar();
+}
+
+/** 
+ * nextFrame	-	display the next frame of the sequence
+ *
+ */
+void VideoProcessor::nextFrame()
+{
+    pauseIt();
+    if (curPos < length)
+        showFrameAt(curPos);
+    emit updateProgressBar();
+}
+
+/** 
+ * jumpTo	-	Jump to a position
+ *
+ * @param index	-	frame index
+ *
+ * @return True if success. False otherwise
+ */
+bool VideoProcessor::jumpTo(long index)
+{
+    if (index >= length){
+        return 1;
+    }
+
+    // the player has decoded ahead, restart it from the new position
+    bool playing = player.joinable() && !isStop();
+    stopPlayback();
+
+    bool re = capture.set(CV_CAP_PROP_POS_FRAMES, index);
+    if (re)
+        curPos = index;
+
+    if (re && playing){
+        stop = false;
+        startPlayback();
+    }
+
+    return re;
+}
+
+/**
+ * showFrameAt	-	show a frame, for stepping and scrubbing
+ *
+ * While playing, the player restarts from the frame.
+ *
+ * @param index	-	frame index
+ *
+ * @return True if success. False otherwise
+ */
+bool VideoProcessor::showFrameAt(long index)
+{
+    if (index < 0 || index >= length)
+        return false;
+
+    if (player.joinable() && !isStop())
+        return jumpTo(index);
+    stopPlayback();
+
+    cv::Mat frame;
+    if (!getFrame(index, frame))
+        return false;
+    curPos = index + 1;
+    emit showFrame(frame);
+    return true;
+}
+
+/**
+ * getFrame	-	get a frame by its index
+ *
+ * Frames are served from the frame cache when possible. Otherwise
+ * a frame shortly ahead of the capture is read forward to, and one
+ * shortly behind is decoded with the SEEK_BLOCK frames before it,
+ * so that stepping back only seeks once per block. A distant frame,
+ * or any frame of a frame store, is seeked to directly. The capture
+ * is left anywhere.
+ *
+ * Not to be called while playing.
+ *
+ * @param index	-	frame index
+ * @param frame	-	the frame, shared with the cache
+ *
+ * @return True if success. False otherwise
+ */
+bool VideoProcessor::getFrame(long index, cv::Mat &frame)
+{
+    return decodeFrame(index, frame, false);
+}
+
+/**
+ * decodeFrame	-	get a frame by its index, see getFrame()
+ *
+ * @param index         -	frame index
+ * @param frame         -	the frame, shared with the cache
+ * @param cancellable	-	give up once a newer seek is requested
+ *
+ * @return True if success. False otherwise
+ */
+bool VideoProcessor::decodeFrame(long index, cv::Mat &frame, bool cancellable)
+{
+    if (frameCache.get(index, frame))
+        return true;
+
+    long at = static_cast<long>(capture.get(CV_CAP_PROP_POS_FRAMES));
+    long from = index;
+    // frame stores seek exactly without decoding, blocks don't pay
+    bool store = capture.isStore();
+    if (!store && index >= at && index - at <= SEEK_BLOCK)
+        from = at;
+    else if (!store && index < at && at - index <= SEEK_BLOCK)
+        from = std::max(index - SEEK_BLOCK + 1, 0L);
+    if (from != at && !capture.set(CV_CAP_PROP_POS_FRAMES, from))
+        return false;
+
+    for (long i = from; i <= index; ++i) {
+        if (cancellable && seekTarget >= 0)
+            return false;
+        // a fresh Mat for each frame, as the cached ones are shared
+        cv::Mat decoded;
+        if (!capture.read(decoded))
+            return false;
+        frameCache.put(i, decoded);
+        frame = decoded;
+    }
+    return true;
+}
+
+/**
+ * requestSeek	-	show a frame in the background, for the slider
+ *
+ * Returns at once. Only the newest of the requests which arrive while
+ * a frame is being decoded is served, and the decode in progress is
+ * given up between frames. A cached frame near the target is shown
+ * first, then the exact one. Playing resumes from there.
+ *
+ * @param index	-	frame index
+ */
+void VideoProcessor::requestSeek(long index)
+{
+    if (index < 0 || index >= length)
+        return;
+
+    // the player would share the capture with the seeker
+    if (player.joinable()) {
+        if (!isStop())
+            resumeAfterSeek = true;
+        stop = true;
+        player.join();
+        stop = !resumeAfterSeek;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(seekLock);
+        seekTarget = index;
+    }
+    if (!seeker.joinable())
+        seeker = std::thread(&VideoProcessor::seekStage, this);
+    seekWake.notify_one();
+}
+
+/**
+ * seekStage	-	the seeker thread
+ *
+ */
+void VideoProcessor::seekStage()
+{
+    std::unique_lock<std::mutex> guard(seekLock);
+    while (true) {
+        while (!seekQuit && seekTarget < 0)
+            seekWake.wait(guard);
+        if (seekQuit)
+            break;
+        long index = seekTarget.exchange(-1);
+        seekBusy = true;
+        guard.unlock();
+
+        // a frame close by while the exact one is decoded
+        cv::Mat frame;
+        long distance = std::max(static_cast<long>(rate), SEEK_BLOCK);
+        long near = frameCache.nearest(index, distance, frame);
+        if (near >= 0 && near != index)
+            emit showFrame(frame);
+
+        if (near == index || decodeFrame(index, frame, true)) {
+            curPos = index + 1;
+            emit showFrame(frame);
+            emit updateProgressBar();
+        }
+
+        guard.lock();
+        seekBusy = false;
+        seekIdle.notify_all();
+        if (seekTarget < 0)
+            emit seeked();
+    }
+}
+
+/**
+ * waitSeek	-	drop the pending seek and wait for the seeker
+ *
+ */
+void VideoProcessor::waitSeek()
+{
+    std::unique_lock<std::mutex> guard(seekLock);
+    seekTarget = -1;
+    while (seekBusy)
+        seekIdle.wait(guard);
+}
+
+/**
+ * resumePlayback	-	resume playing after the seeks of the slider
+ *
+ */
+void VideoProcessor::resumePlayback()
+{
+    if (!resumeAfterSeek || seekTarget >= 0)
+        return;
+    {
+        std::lock_guard<std::mutex> guard(seekLock);
+        if (seekBusy)
+            return;
+    }
+    resumeAfterSeek = false;
+    stop = false;
+    startPlayback();
+}
+
+/**
+ * setCacheBudget	-	set the memory of the decoded frame cache
+ *
+ * @param bytes	-	the budget in bytes, 0 disables the cache
+ */
+void VideoProcessor::setCacheBudget(size_t bytes)
+{
+    frameCache.setBudget(bytes);
+}
+
+
+/** 
+ * jumpToMS	-	jump to a position at a time
+ *
+ * @param pos	-	time
+ *
+ * @return True if success. False otherwise
+ *
+ */
+bool VideoProcessor::jumpToMS(double pos)
+{
+    return capture.set(CV_CAP_PROP_POS_MSEC, pos);
+}
+
+
+/** 
+ * close	-	close the video
+ *
+ */
+void VideoProcessor::close()
+{
+    stopPlayback();
+    frameCache.clear();
+    curPos = 0;
+    rate = 0;
+    length = 0;
+    modify = 0;
+    capture.release();
+    writer.release();
+    tempWriter.release();
+}
+
+
+/** 
+ * isStop	-	Is the processing stop
+ *
+ *
+ * @return True if not processing/playing. False otherwise
+ */
+bool VideoProcessor::isStop()
+{
+    return stop;
+}
+
+/** 
+ * isModified	-	Is the video modified?
+ *
+ *
  * @return True if modified. False otherwise
  */
 bool VideoProcessor::isModified()
@@ -758,45 +1707,174 @@ void VideoProcessor::writeNextFrame(cv::Mat &frame)
     }
 }
 
+/**
+ * decodeStage	-	decode stage of the processing pipeline
+ *
+ * Runs on its own thread and owns the capture until the queue is
+ * closed or cancelled.
+ *
+ * @param queue	-	queue of decoded frames
+ */
+void VideoProcessor::decodeStage(FrameQueue<cv::Mat> *queue)
+{
+    for (long n = 0; ; ++n) {
+        // a fresh Mat for each frame, as the queued ones are still in use
+        cv::Mat frame;
+        StageTimer timer(*profiler, n, "decode");
+        bool more = getNextFrame(frame);
+        timer.end();
+        if (!more || !queue->push(frame))
+            break;
+    }
+    queue->close();
+}
+
+/**
+ * encodeStage	-	encode stage of the processing pipeline
+ *
+ * Runs on its own thread and owns the temp writer. A frame which
+ * can't be written, e.g. on a full disk, cancels the processing.
+ *
+ * @param queue	-	queue of frames to be written
+ */
+void VideoProcessor::encodeStage(FrameQueue<cv::Mat> *queue)
+{
+    cv::Mat frame;
+    for (long n = 0; queue->pop(frame); ++n) {
+        StageTimer timer(*profiler, n, "write");
+        if (!tempWriter.write(frame)) {
+            stop = true;
+            queue->cancel();
+            break;
+        }
+    }
+}
+
 /** 
  * playIt	-	play the frames of the sequence
  *
+ * The frames are decoded and shown on a player thread,
+ * this returns at once.
  */
 void VideoProcessor::playIt()
 {
-    // current frame
-    cv::Mat input;
-
     // if no capture device has been set
     if (!isOpened())
         return;
 
+    // join a player which reached the end by itself
+    stopPlayback();
+
     // is playing
     stop = false;
 
     // update buttons
     emit updateBtn();
 
-    while (!isStop()) {
+    startPlayback();
+}
+
+/**
+ * startPlayback	-	start the player thread from the current position
+ *
+ */
+void VideoProcessor::startPlayback()
+{
+    // stepping and the player's decoder leave the capture anywhere
+    if (static_cast<long>(capture.get(CV_CAP_PROP_POS_FRAMES)) != curPos)
+        capture.set(CV_CAP_PROP_POS_FRAMES, curPos);
+    shownFrames = 0;
+    droppedFrames = 0;
+    playbackFps = 0;
+    player = std::thread(&VideoProcessor::playStage, this);
+}
+
+/**
+ * stopPlayback	-	stop and join the player thread, and wait for the seeker
+ *
+ */
+void VideoProcessor::stopPlayback()
+{
+    // the seeker shares the capture too
+    waitSeek();
+    resumeAfterSeek = false;
+
+    if (!player.joinable())
+        return;
+
+    stop = true;
+    player.join();
+}
+
+/**
+ * playStage	-	the player thread
+ *
+ * Frame i is due at start + i * delay on the steady clock, so a
+ * slow frame delays only itself. A frame more than a period late
+ * is skipped when the next one is already decoded.
+ */
+void VideoProcessor::playStage()
+{
+    typedef std::chrono::steady_clock clock;
 
-        // read next frame if any
-        if (!getNextFrame(input))
+    FrameQueue<cv::Mat> decoded(playbackBuffer);
+    std::thread decoder(&VideoProcessor::decodeStage, this, &decoded);
+
+    // no pacing for a non-positive delay
+    const clock::duration period = std::chrono::milliseconds(std::max(delay, 0));
+    const clock::duration slice = std::chrono::milliseconds(20);
+
+    clock::time_point start = clock::now();
+    clock::time_point window = start;
+    long windowFrames = 0;
+    long pos = curPos;
+
+    cv::Mat frame;
+    for (long i = 0; !isStop() && decoded.pop(frame); ++i) {
+        // keep the frame for stepping back after a pause
+        frameCache.put(pos, frame);
+        ++pos;
+        clock::time_point deadline = start + i * period;
+
+        if (period > clock::duration::zero() &&
+                clock::now() > deadline + period && decoded.depth() > 0) {
+            ++droppedFrames;
+            curPos = pos;
+            continue;
+        }
+
+        // wait in short slices to stay responsive to pauses
+        for (clock::time_point now = clock::now();
+             now < deadline && !isStop(); now = clock::now())
+            std::this_thread::sleep_until(std::min(deadline, now + slice));
+        if (isStop())
             break;
 
-        curPos = capture.get(CV_CAP_PROP_POS_FRAMES);
+        curPos = pos;
 
         // display input frame
-        emit showFrame(input);
+        emit showFrame(frame);
 
         // update the progress bar
         emit updateProgressBar();
 
-        // introduce a delay
-        emit sleep(delay);
+        ++shownFrames;
+        ++windowFrames;
+        clock::time_point now = clock::now();
+        if (now - window >= std::chrono::seconds(1)) {
+            playbackFps = windowFrames /
+                    std::chrono::duration<double>(now - window).count();
+            window = now;
+            windowFrames = 0;
+        }
     }
-    if (!isStop()){
+
+    bool ended = !isStop();
+    decoded.cancel();
+    decoder.join();
+
+    if (ended)
         emit revert();
-    }
 }
 
 /** 
@@ -805,6 +1883,7 @@ void VideoProcessor::playIt()
  */
 void VideoProcessor::pauseIt()
 {
+    stopPlayback();
     stop = true;
     emit updateBtn();
 }
@@ -815,10 +1894,19 @@ void VideoProcessor::pauseIt()
  */
 void VideoProcessor::motionMagnify()
 {
+    if (motionFilter == RIESZ) {
+        motionMagnifyRiesz();
+        return;
+    }
+
     // set filter
     setSpatialFilter(LAPLACIAN);
     setTemporalFilter(IIR);
 
+    // re-render the source if the video is the last result
+    // and the bands of the source are cached
+    std::string source = renderSource(false);
+
     // create a temp file
     createTemp();
 
@@ -826,6 +1914,8 @@ void VideoProcessor::motionMagnify()
     cv::Mat input;
     // output frame
     cv::Mat output;
+    // current frame in Lab color space
+    cv::Mat s;
 
     // motion image
     cv::Mat motion;
@@ -833,6 +1923,17 @@ void VideoProcessor::motionMagnify()
     std::vector<cv::Mat> pyramid;
     std::vector<cv::Mat> filtered;
 
+    // amplification factor of each level
+    std::vector<float> factors;
+    // strips of the levels to be filtered
+    std::vector<LevelStrip> strips;
+    // tiles of the frame, if it is tiled
+    std::vector<MotionTile> tiles;
+    // bandpassed levels of a frame, from the band cache
+    std::vector<cv::Mat> bands;
+    // unit gains, to record the levels before amplification
+    std::vector<float> unitGains;
+
     // if no capture device has been set
     if (!isOpened())
         return;
@@ -840,99 +1941,301 @@ void VideoProcessor::motionMagnify()
     // set the modify flag to be true
     modify = true;
 
-    // is processing
-    stop = false;
+    // if asked, frames are split into tiles which are magnified
+    // separately, each with its own pyramid and IIR state
+    cv::Size frameSize = getFrameSize();
+    if (tileSize != 0) {
+        int size = tileSize;
+        if (size < 0) {
+            // a core of four halos on a side, so that the halos
+            // add at most 1.25 times the pyramid work of the core
+            // (sized from the halo, not the L2, see setTileSize)
+            int halo = 4 << levels;
+            size = 4 * halo;
+        }
+        std::vector<PyramidTile> geometry;
+        splitPyramidTiles(frameSize, levels, size, geometry);
+        tiles.resize(geometry.size());
+        for (size_t i = 0; i < geometry.size(); ++i)
+            tiles[i].geometry = geometry[i];
+    }
+
+    // the levels of an untiled run with the same source, levels and
+    // cut-offs only need to be amplified again, otherwise they are
+    // recorded for the next run
+    BandCacheKey cacheKey(source, levels, fl, fh, IIR, precision, length);
+    bool cached = bandCaching && tiles.empty() && bandCache.matches(cacheKey);
+    bool recording = false;
+    if (!cached)
+        bandCache.clear();
 
     // save the current position
     long pos = curPos;
     // jump to the first frame
     jumpTo(0);
 
+    // decode, magnify and encode run as three overlapping stages:
+    // the decoder and the encoder get their own threads, connected
+    // to this one by bounded queues which keep the frame order
+    FrameQueue<cv::Mat> decoded(pipelineDepth);
+    FrameQueue<cv::Mat> encoded(pipelineDepth);
+    std::thread decoder(&VideoProcessor::decodeStage, this, &decoded);
+    std::thread encoder(&VideoProcessor::encodeStage, this, &encoded);
+
     while (!isStop()) {
 
-        // read next frame if any
-        if (!getNextFrame(input))
+        // take next decoded frame if any
+        if (!decoded.pop(input))
             break;
 
-        input.convertTo(input, CV_32FC3, 1.0/255.0f);
+        // times the steps of this frame
+        StageTimer timer(*profiler, fnumber, "lab");
+
+        // the float buffers below are reused from frame to frame
+        input.convertTo(s, CV_32FC3, 1.0/255.0f);
 
         // 1. convert to Lab color space
-        cv::cvtColor(input, input, CV_BGR2Lab);
-
-        // 2. spatial filtering one frame
-        cv::Mat s = input.clone();
-        spatialFilter(s, pyramid);
-
-        // 3. temporal filtering one frame's pyramid
-        // and amplify the motion
-        if (fnumber == 0){      // is first frame
-            lowpass1 = pyramid;
-            lowpass2 = pyramid;
-            filtered = pyramid;
-        } else {
-            for (int i=0; i<levels; ++i) {
-                curLevel = i;
-                temporalFilter(pyramid.at(i), filtered.at(i));
+        cv::cvtColor(s, s, CV_BGR2Lab);
+
+        if (!tiles.empty()) {
+            // 2-5. the pipeline below, one tile per worker
+            timer.begin("tiles");
+            if (fnumber == 0)
+                bandFactors(s.size(), factors);
+            motion.create(s.size(), s.type());
+            cv::parallel_for_(cv::Range(0, (int)tiles.size()),
+                              TileFilter(this, s, motion, tiles, factors, fnumber == 0));
+        } else if (cached) {
+            // 2-3. the cached levels, amplified
+            timer.begin("cached bands");
+            if (fnumber == 0) {
+                bandFactors(s.size(), factors);
+                filtered.resize(levels+1);
+                cv::Size size = s.size();
+                for (int i=0; i<=levels; ++i) {
+                    filtered[i] = cv::Mat::zeros(size, s.type());
+                    size = cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+                }
+            }
+            if (fnumber < bandCache.length()) {
+                bandCache.load(fnumber, bands);
+                for (int i=1; i<levels; ++i)
+                    bands[i].convertTo(filtered[i], -1, factors[i]);
+            } else {
+                // more frames than the source had, nothing to add
+                for (int i=1; i<levels; ++i)
+                    filtered[i].setTo(cv::Scalar::all(0));
             }
 
-            // amplify each spatial frequency bands
-            // according to Figure 6 of paper            
-            cv::Size filterSize = filtered.at(0).size();
-            int w = filterSize.width;
-            int h = filterSize.height;
-
-            delta = lambda_c/8.0/(1.0+alpha);
-            // the factor to boost alpha above the bound
-            // (for better visualization)
-            exaggeration_factor = 2.0;
-
-            // compute the representative wavelength lambda
-            // for the lowest spatial frequency band of Laplacian pyramid
-            lambda = sqrt(w*w + h*h)/3;  // 3 is experimental constant
-
-            for (int i=levels; i>=0; i--) {
-                curLevel = i;
-
-                amplify(filtered.at(i), filtered.at(i));
+            // 4. reconstruct motion image from filtered pyramid
+            timer.begin("reconstruct");
+            reconImgFromLaplacianPyramid(filtered, levels, motion, workspace);
 
-                // go one level down on pyramid
-                // representative lambda will reduce by factor of 2
-                lambda /= 2.0;
+            // 5. attenuate I, Q channels
+            timer.begin("attenuate");
+            attenuate(motion, motion);
+        } else {
+            // 2. spatial filtering one frame
+            timer.begin("spatial");
+            spatialFilter(s, pyramid);
+
+            // 3. temporal filtering one frame's pyramid
+            // and amplify the motion
+            timer.begin("temporal+amplify");
+            if (fnumber == 0){      // is first frame
+                lowpass1.resize(levels);
+                lowpass2.resize(levels);
+                filtered.resize(levels+1);
+                for (int i=0; i<levels; ++i) {
+                    packImage(pyramid.at(i), lowpass1[i], precision);
+                    packImage(pyramid.at(i), lowpass2[i], precision);
+                }
+                // the highest band is never amplified and stays zero
+                for (int i=0; i<=levels; ++i)
+                    filtered[i] = cv::Mat::zeros(pyramid.at(i).size(), pyramid.at(i).type());
+
+                // amplify each spatial frequency bands
+                // according to Figure 6 of paper
+                bandFactors(pyramid.at(0).size(), factors);
+
+                // split the levels into strips of similar size,
+                // so that the large levels use more than one core.
+                // level 0 is always amplified by zero, its band
+                // never reaches the output and needn't be filtered
+                strips.clear();
+                for (int i=1; i<levels; ++i) {
+                    const cv::Mat &level = pyramid.at(i);
+                    int rows = std::max(1, STRIP_PIXELS / std::max(level.cols, 1));
+                    for (int r = 0; r < level.rows; r += rows)
+                        strips.push_back(LevelStrip(i, cv::Range(r, std::min(r + rows, level.rows))));
+                }
+
+                // record the filtered levels 1 to levels-1
+                std::vector<cv::Mat> layout(levels+1);
+                for (int i=1; i<levels; ++i)
+                    layout[i] = filtered[i];
+                recording = bandCaching
+                        && bandCache.create(cacheKey, layout, length,
+                                            effectiveMemoryLimit(), scratchDir)
+                        && bandCache.store(0, filtered);
+                unitGains.assign(levels+1, 1.0f);
+            } else if (recording) {
+                // filter without amplifying, record, then amplify
+                cv::parallel_for_(cv::Range(0, (int)strips.size()),
+                                  LevelFilter(this, pyramid, filtered, unitGains, strips));
+                recording = bandCache.store(fnumber, filtered);
+                for (int i=1; i<levels; ++i)
+                    filtered[i].convertTo(filtered[i], -1, factors[i]);
+            } else {
+                cv::parallel_for_(cv::Range(0, (int)strips.size()),
+                                  LevelFilter(this, pyramid, filtered, factors, strips));
             }
-        }
 
-        // 4. reconstruct motion image from filtered pyramid
-        reconImgFromLaplacianPyramid(filtered, levels, motion);
+            // 4. reconstruct motion image from filtered pyramid
+            timer.begin("reconstruct");
+            reconImgFromLaplacianPyramid(filtered, levels, motion, workspace);
 
-        // 5. attenuate I, Q channels
-        attenuate(motion, motion);
+            // 5. attenuate I, Q channels
+            timer.begin("attenuate");
+            attenuate(motion, motion);
+        }
 
         // 6. combine source frame and motion image
+        timer.begin("combine");
         if (fnumber > 0)    // don't amplify first frame
             s += motion;
 
         // 7. convert back to rgb color space and CV_8UC3
-        output = s.clone();
-        cv::cvtColor(output, output, CV_Lab2BGR);
-        output.convertTo(output, CV_8UC3, 255.0, 1.0/255.0);
+        // (a fresh Mat, as the queued ones are still in use)
+        timer.begin("bgr");
+        output = cv::Mat();
+        cv::cvtColor(s, s, CV_Lab2BGR);
+        s.convertTo(output, CV_8UC3, 255.0, 1.0/255.0);
+
+        // hand the frame over to the encoder
+        timer.begin("enqueue");
+        encoded.push(output);
+        timer.end();
+
+        reportProgress("Processing...", ++fnumber);
+    }
+    // stop the decoder if it is still running,
+    // and let the encoder drain its queue
+    decoded.cancel();
+    encoded.close();
+    decoder.join();
+    encoder.join();
+    decodeStats = decoded.stats();
+    encodeStats = encoded.stats();
+
+    // keep the recorded levels of a complete run only, with a
+    // record for every frame of the source
+    if (recording && !isStop() && fnumber == length)
+        bandCache.finish(fnumber);
+    else if (!cached)
+        bandCache.clear();
+
+    // change the video to the processed video, or drop a cancelled run
+    finishRender(source, !isStop());
 
-        // write the frame to the temp file
-        tempWriter.write(output);
+    // jump back to the original position
+    jumpTo(pos);
+}
 
-        // update process
-        std::string msg= "Processing...";
-        emit updateProcessProgress(msg, floor((fnumber++) * 100.0 / length));
-    }
-    if (!isStop()){
-        emit revert();
-    }
-    emit closeProgressDialog();
+/**
+ * motionMagnifyRiesz	-	phase-based motion magnification
+ *
+ * The luminance of each frame goes through a RieszMagnifier, whose
+ * phase band uses the IIR cut-offs of motion magnification. The
+ * chrominance is kept as is. Runs as a decode, magnify and encode
+ * pipeline like motionMagnify.
+ */
+void VideoProcessor::motionMagnifyRiesz()
+{
+    // set filter
+    setSpatialFilter(RIESZ);
+    setTemporalFilter(IIR);
 
-    // release the temp writer
-    tempWriter.release();
+    // the input video, before it is replaced by the temp file
+    std::string source = renderSource(false);
 
-    // change the video to the processed video 
-    setInput(tempFile);
+    // create a temp file
+    createTemp();
+
+    // current frame
+    cv::Mat input;
+    // output frame
+    cv::Mat output;
+    // current frame in Lab color space
+    cv::Mat s;
+    // luminance of the current frame
+    cv::Mat luma;
+    RieszMagnifier magnifier;
+
+    // if no capture device has been set
+    if (!isOpened())
+        return;
+
+    magnifier.setLevels(levels);
+    magnifier.setCutoffs(fl, fh);
+    magnifier.setAlpha(alpha);
+
+    // set the modify flag to be true
+    modify = true;
+
+    // save the current position
+    long pos = curPos;
+    // jump to the first frame
+    jumpTo(0);
+
+    FrameQueue<cv::Mat> decoded(pipelineDepth);
+    FrameQueue<cv::Mat> encoded(pipelineDepth);
+    std::thread decoder(&VideoProcessor::decodeStage, this, &decoded);
+    std::thread encoder(&VideoProcessor::encodeStage, this, &encoded);
+
+    fnumber = 0;
+    while (!isStop()) {
+
+        // take next decoded frame if any
+        if (!decoded.pop(input))
+            break;
+
+        // 1. convert to Lab color space
+        StageTimer timer(*profiler, fnumber, "lab");
+        input.convertTo(s, CV_32FC3, 1.0/255.0f);
+        cv::cvtColor(s, s, CV_BGR2Lab);
+
+        // 2-5. shift the phase of the luminance
+        timer.begin("riesz");
+        cv::extractChannel(s, luma, 0);
+        magnifier.magnify(luma, luma);
+        cv::insertChannel(luma, s, 0);
+
+        // 6. convert back to rgb color space and CV_8UC3
+        // (a fresh Mat, as the queued ones are still in use)
+        timer.begin("bgr");
+        output = cv::Mat();
+        cv::cvtColor(s, s, CV_Lab2BGR);
+        s.convertTo(output, CV_8UC3, 255.0, 1.0/255.0);
+
+        // hand the frame over to the encoder
+        timer.begin("enqueue");
+        encoded.push(output);
+        timer.end();
+
+        reportProgress("Processing...", ++fnumber);
+    }
+    // stop the decoder if it is still running,
+    // and let the encoder drain its queue
+    decoded.cancel();
+    encoded.close();
+    decoder.join();
+    encoder.join();
+    decodeStats = decoded.stats();
+    encodeStats = encoded.stats();
+
+    // change the video to the processed video, or drop a cancelled run
+    finishRender(source, !isStop());
 
     // jump back to the original position
     jumpTo(pos);
@@ -944,10 +2247,23 @@ void VideoProcessor::motionMagnify()
  */
 void VideoProcessor::colorMagnify()
 {
+    if (colorFilter == BUTTERWORTH) {
+        colorMagnifyButterworth();
+        return;
+    }
+    if (streaming) {
+        colorMagnifyStreaming();
+        return;
+    }
+
     // set filter
     setSpatialFilter(GAUSSIAN);
     setTemporalFilter(IDEAL);
 
+    // re-render the source if the video is the last result
+    // and the bands of the source are cached
+    std::string source = renderSource(true);
+
     // create a temp file
     createTemp();
 
@@ -963,26 +2279,46 @@ void VideoProcessor::colorMagnify()
 
     // video frames
     std::vector<cv::Mat> frames;
-    // down-sampled frames
-    std::vector<cv::Mat> downSampledFrames;
+    // pyramid of the current frame
+    std::vector<cv::Mat> pyramid;
+    // down-sampled frames, stored as one time series per pixel
+    TimeSeriesBuffer downSampledFrames;
     // filtered frames
     std::vector<cv::Mat> filteredFrames;
 
-    // concatenate image of all the down-sample frames
-    cv::Mat videoMat;
-    // concatenate filtered image
-    cv::Mat filtered;
-
     // if no capture device has been set
     if (!isOpened())
         return;
 
+    // spill the frames and the time series to scratch files
+    // when they don't fit in the memory limit
+    cv::Size frameSize = getFrameSize();
+    cv::Size coarseSize = frameSize;
+    for (int l = 0; l < levels; ++l)
+        coarseSize = cv::Size((coarseSize.width + 1) / 2, (coarseSize.height + 1) / 2);
+    // the frames are buffered in the chosen precision
+    int frameType = storageType(CV_32FC3, precision);
+    size_t frameBytes = size_t(frameSize.area()) * CV_ELEM_SIZE(frameType);
+    size_t coarseBytes = size_t(coarseSize.area()) * 3 * sizeof(float);
+    size_t frameStride = cv::alignSize(frameBytes, 4096);
+    long frameCount = std::max(length, 1L);
+    // full resolution frames, time series and filtered frames
+    bool spill = exceedsMemoryLimit(frameCount * (frameBytes + 2 * coarseBytes));
+    ScratchFile frameStore;
+    ScratchFile filteredStore;
+    if (spill && !frameStore.open(frameCount * frameStride, scratchDir))
+        spill = false;
+
+    // the filtered series of a run with the same source, levels and
+    // cut-offs only need to be amplified again
+    BandCacheKey cacheKey(source, levels, fl, fh, IDEAL, precision, length);
+    bool cached = bandCaching && bandCache.matches(cacheKey);
+    if (!cached)
+        bandCache.clear();
+
     // set the modify flag to be true
     modify = true;
 
-    // is processing
-    stop = false;
-
     // save the current position
     long pos = curPos;
 
@@ -991,70 +2327,375 @@ void VideoProcessor::colorMagnify()
 
     // 1. spatial filtering
     while (getNextFrame(input) && !isStop()) {
-        input.convertTo(temp, CV_32FC3);
-        frames.push_back(temp.clone());
+        StageTimer timer(*profiler, frames.size(), "spatial");
+        // the frame goes straight into the scratch file if spilled,
+        // frames past the expected length fall back to RAM
+        cv::Mat stored;
+        if (spill)
+            stored = frameStore.mat(frames.size() * frameStride,
+                                    frameSize.height, frameSize.width, frameType);
+        if (precision == FULL_PRECISION) {
+            input.convertTo(stored, CV_32FC3);
+            temp = stored;
+        } else {
+            // filter the float frame, buffer the reduced one
+            input.convertTo(temp, CV_32FC3);
+            packImage(temp, stored, precision);
+        }
+        frames.push_back(stored);
+        if (cached) {
+            timer.end();
+            reportProgress("Decoding...", ++fnumber);
+            continue;
+        }
         // spatial filtering
-        std::vector<cv::Mat> pyramid;
         spatialFilter(temp, pyramid);
-        downSampledFrames.push_back(pyramid.at(levels-1));
-        // update process
-        std::string msg= "Spatial Filtering...";
-        emit updateProcessProgress(msg, floor((fnumber++) * 100.0 / length));
+        // 2. concat all the frames into a single large Mat
+        // where each row is the time series of one pixel
+        // (for processing convenience)
+        const cv::Mat &coarse = pyramid.at(levels-1);
+        if (downSampledFrames.length() == 0)
+            downSampledFrames.create(coarse.size(), coarse.type(), length,
+                                     spill ? scratchDir : std::string());
+        downSampledFrames.push(coarse);
+        // the progress signal is not part of the stage
+        timer.end();
+        reportProgress("Spatial Filtering...", ++fnumber);
     }
-    if (isStop()){
-        emit closeProgressDialog();
+    if (isStop() || frames.empty()){
+        finishRender(source, false);
         fnumber = 0;
         return;
     }
-    emit closeProgressDialog();
-
-    // 2. concat all the frames into a single large Mat
-    // where each column is a reshaped single frame
-    // (for processing convenience)
-    concat(downSampledFrames, videoMat);
 
-    // 3. temporal filtering
-    temporalFilter(videoMat, filtered);
+    cv::Mat videoMat;
+    StageTimer timer(*profiler, -1, "temporal");
+    if (cached) {
+        // 3-4. amplify the cached filtered series,
+        // into a new buffer so that the cache is kept
+        std::vector<cv::Mat> series;
+        bandCache.load(0, series);
+        timer.begin("amplify");
+        amplify(series.at(0), videoMat, alpha);
+    } else {
+        // concatenate image of all the down-sample frames
+        videoMat = downSampledFrames.series();
+
+        // 3. temporal filtering, in place
+        temporalFilter(videoMat, videoMat);
+        if (isStop()) {
+            finishRender(source, false);
+            fnumber = 0;
+            return;
+        }
 
-    // 4. amplify color motion
-    amplify(filtered, filtered);
+        // keep the filtered series for the next run, if it has
+        // every frame of the source
+        std::vector<cv::Mat> series(1, videoMat);
+        if (bandCaching && (long)frames.size() == length
+                && bandCache.create(cacheKey, series, 1, effectiveMemoryLimit(), scratchDir)
+                && bandCache.store(0, series))
+            bandCache.finish(1);
+
+        // 4. amplify color motion
+        timer.begin("amplify");
+        amplify(videoMat, videoMat, alpha);
+    }
 
     // 5. de-concat the filtered image into filtered frames
-    deConcat(filtered, downSampledFrames.at(0).size(), filteredFrames);
+    timer.begin("deconcat");
+    cv::Mat filteredStorage;
+    if (spill && filteredStore.open(videoMat.total() * videoMat.elemSize(), scratchDir))
+        filteredStorage = filteredStore.mat(0, videoMat.cols, videoMat.rows, videoMat.type());
+    deConcat(videoMat, coarseSize, filteredFrames, filteredStorage);
+    timer.end();
 
     // 6. amplify each frame
     // by adding frame image and motions
-    // and write into video
+    // and write into video on the encoder thread
+    FrameQueue<cv::Mat> encoded(pipelineDepth);
+    std::thread encoder(&VideoProcessor::encodeStage, this, &encoded);
     fnumber = 0;
-    for (int i=0; i<length-1 && !isStop(); ++i) {
-        // up-sample the motion image        
-        upsamplingFromGaussianPyramid(filteredFrames.at(i), levels, motion);
-	resize(motion, motion, frames.at(i).size());
-        temp = frames.at(i) + motion;
-        output = temp.clone();
-        double minVal, maxVal;
-        minMaxLoc(output, &minVal, &maxVal); //find minimum and maximum intensities
-        output.convertTo(output, CV_8UC3, 255.0/(maxVal - minVal),
-                  -minVal * 255.0/(maxVal - minVal));
-        tempWriter.write(output);
-        std::string msg= "Amplifying...";
-        emit updateProcessProgress(msg, floor((fnumber++) * 100.0 / length));
+    int count = (int)std::min(filteredFrames.size(), frames.size());
+    for (int i=0; i<count && !isStop(); ++i) {
+        StageTimer frameTimer(*profiler, i, "compose");
+        cv::Mat frame = frames.at(i);
+        if (frame.depth() != CV_32F) {
+            unpackImage(frame, temp);
+            frame = temp;
+        }
+        // a fresh Mat for each frame, as the queued ones are still in use
+        output = cv::Mat();
+        composeColorFrame(frame, filteredFrames.at(i), output);
+        frameTimer.end();
+        if (!encoded.push(output))
+            break;
+        reportProgress("Amplifying...", ++fnumber);
     }
-    if (!isStop()) {
-        emit revert();
+    encoded.close();
+    encoder.join();
+    encodeStats = encoded.stats();
+
+    // change the video to the processed video, or drop a cancelled run
+    finishRender(source, !isStop());
+
+    // jump back to the original position
+    jumpTo(pos);
+}
+
+/**
+ * colorMagnifyStreaming	-	color magnification over a sliding window
+ *
+ * The coarse gaussian levels are filtered in windows of streamWindow
+ * frames which advance by half a window (overlap-save). Only the middle
+ * half of each window is written, so the window edges never reach the
+ * output. Full resolution frames are not buffered: a second decoder
+ * trails the first one by the filter latency and provides them.
+ * Memory is O(window x coarse frame size).
+ */
+void VideoProcessor::colorMagnifyStreaming()
+{
+    // set filter
+    setSpatialFilter(GAUSSIAN);
+    setTemporalFilter(IDEAL);
+
+    // the input video, before it is replaced by the temp file
+    std::string source = renderSource(true);
+
+    // create a temp file
+    createTemp();
+
+    // current frame
+    cv::Mat input;
+    // output frame
+    cv::Mat output;
+    // temp image
+    cv::Mat temp;
+
+    // if no capture device has been set
+    if (!isOpened())
+        return;
+
+    // a second decoder for the full resolution frames
+    FrameSource lagCapture(source);
+    if (!lagCapture.isOpened()) {
+        finishRender(source, false);
+        return;
     }
-    emit closeProgressDialog();
 
-    // release the temp writer
-    tempWriter.release();
+    // window length, a multiple of 4 so that
+    // the window can be split into quarters
+    int window = streamWindow;
+    if (window <= 0) {
+        // two periods of the low cut-off frequency
+        window = cvCeil(2.0 * rate / std::max(fl, 0.001f));
+        window = std::min(std::max(window, 32), 512);
+    }
+    window = std::max((window + 3) / 4 * 4, 8);
+    int hop = window / 2;
+    int margin = window / 4;
+
+    // down-sampled frames of the current window
+    std::deque<cv::Mat> coarse;
+    // index of the first frame in the window
+    long windowStart = 0;
+    // number of frames written so far
+    long emitted = 0;
+
+    // set the modify flag to be true
+    modify = true;
+
+    // save the current position
+    long pos = curPos;
+
+    // jump to the first frame, both decoders start there
+    jumpTo(0);
+
+    // the frames are written on the encoder thread
+    FrameQueue<cv::Mat> encoded(pipelineDepth);
+    std::thread encoder(&VideoProcessor::encodeStage, this, &encoded);
+
+    fnumber = 0;
+    while (true) {
+        bool more = getNextFrame(input);
+        if (isStop())
+            break;
+
+        // 1. spatial filtering
+        if (more) {
+            StageTimer timer(*profiler, windowStart + (long)coarse.size(), "spatial");
+            input.convertTo(temp, CV_32FC3);
+            std::vector<cv::Mat> pyramid;
+            spatialFilter(temp, pyramid);
+            coarse.push_back(pyramid.at(levels-1));
+        }
+
+        // wait until the window is full or the input ends
+        if (more && (int)coarse.size() < window)
+            continue;
+        long end = more ? windowStart + window - margin
+                        : windowStart + (long)coarse.size();
+        if (emitted >= end)
+            break;
+
+        // 2. concat the window into a single large Mat
+        StageTimer timer(*profiler, windowStart, "concat");
+        std::vector<cv::Mat> windowFrames(coarse.begin(), coarse.end());
+        cv::Mat videoMat, filtered;
+        concat(windowFrames, videoMat);
+
+        // 3. temporal filtering
+        timer.begin("temporal");
+        idealBandpass(videoMat, filtered);
+
+        // 4. amplify color motion
+        timer.begin("amplify");
+        amplify(filtered, filtered, alpha);
+
+        // 5. de-concat the window
+        timer.begin("deconcat");
+        std::vector<cv::Mat> filteredFrames;
+        deConcat(filtered, windowFrames.at(0).size(), filteredFrames);
+        timer.end();
+
+        // 6. amplify the frames in the middle of the window
+        for (long t = emitted; t < end && !isStop(); ++t) {
+            StageTimer frameTimer(*profiler, t, "decode");
+            if (!lagCapture.read(input))
+                break;
+            frameTimer.begin("compose");
+            input.convertTo(temp, CV_32FC3);
+            // a fresh Mat for each frame, as the queued ones are still in use
+            output = cv::Mat();
+            composeColorFrame(temp, filteredFrames.at(t - windowStart), output);
+            frameTimer.end();
+            if (!encoded.push(output))
+                break;
+            reportProgress("Amplifying...", ++fnumber);
+        }
+        emitted = end;
 
-    // change the video to the processed video
-    setInput(tempFile);
+        if (!more)
+            break;
+
+        // slide the window
+        for (int i = 0; i < hop; ++i)
+            coarse.pop_front();
+        windowStart += hop;
+    }
+    lagCapture.release();
+    encoded.close();
+    encoder.join();
+    encodeStats = encoded.stats();
+
+    // change the video to the processed video, or drop a cancelled run
+    finishRender(source, !isStop());
 
     // jump back to the original position
     jumpTo(pos);
 }
 
+/**
+ * colorMagnifyButterworth	-	color magnification with a causal filter
+ *
+ * The coarse gaussian level of each frame goes through a Butterworth
+ * bandpass whose cut-offs are fl and fh in Hz, and the amplified band
+ * is added back to the frame right away. Like motion magnification it
+ * runs as a decode, magnify and encode pipeline; nothing but the
+ * filter states is kept from frame to frame.
+ */
+void VideoProcessor::colorMagnifyButterworth()
+{
+    // set filter
+    setSpatialFilter(GAUSSIAN);
+    setTemporalFilter(BUTTERWORTH);
+
+    // the input video, before it is replaced by the temp file
+    std::string source = renderSource(true);
+
+    // create a temp file
+    createTemp();
+
+    // current frame
+    cv::Mat input;
+    // output frame
+    cv::Mat output;
+    // current frame as floats
+    cv::Mat temp;
+    // amplified band of the coarse level
+    cv::Mat band;
+    // pyramid of the current frame
+    std::vector<cv::Mat> pyramid;
+    ButterworthBandpass filter;
+
+    // if no capture device has been set
+    if (!isOpened())
+        return;
+
+    // cut-offs in Hz, converted with the frame rate
+    filter.design(fl, fh, rate > 0 ? rate : 30.0, filterOrder);
+
+    // set the modify flag to be true
+    modify = true;
+
+    // save the current position
+    long pos = curPos;
+    // jump to the first frame
+    jumpTo(0);
+
+    FrameQueue<cv::Mat> decoded(pipelineDepth);
+    FrameQueue<cv::Mat> encoded(pipelineDepth);
+    std::thread decoder(&VideoProcessor::decodeStage, this, &decoded);
+    std::thread encoder(&VideoProcessor::encodeStage, this, &encoded);
+
+    fnumber = 0;
+    while (!isStop()) {
+
+        // take next decoded frame if any
+        if (!decoded.pop(input))
+            break;
+
+        // 1. spatial filtering
+        StageTimer timer(*profiler, fnumber, "spatial");
+        input.convertTo(temp, CV_32FC3);
+        spatialFilter(temp, pyramid);
+
+        // 2-3. temporal filtering and amplification of the coarse level,
+        // starting from the steady state of the first frame
+        timer.begin("temporal+amplify");
+        const cv::Mat &coarse = pyramid.at(levels-1);
+        if (fnumber == 0)
+            filter.reset(coarse);
+        filter.apply(coarse, band, alpha);
+
+        // 4. add the up-sampled band to the frame
+        // (a fresh Mat, as the queued ones are still in use)
+        timer.begin("compose");
+        output = cv::Mat();
+        composeColorFrame(temp, band, output);
+
+        // hand the frame over to the encoder
+        timer.begin("enqueue");
+        encoded.push(output);
+        timer.end();
+
+        reportProgress("Processing...", ++fnumber);
+    }
+    // stop the decoder if it is still running,
+    // and let the encoder drain its queue
+    decoded.cancel();
+    encoded.close();
+    decoder.join();
+    encoder.join();
+    decodeStats = decoded.stats();
+    encodeStats = encoded.stats();
+
+    // change the video to the processed video, or drop a cancelled run
+    finishRender(source, !isStop());
+
+    // jump back to the original position
+    jumpTo(pos);
+}
 
 /** 
  * writeOutput	-	write the processed result
@@ -1068,6 +2709,20 @@ void VideoProcessor::writeOutput()
     if (!isOpened() || !writer.isOpened())
         return;
 
+    // the same codec, frame rate and container need no transcode
+    char codec[4];
+    if (extension.empty() && outputFile != tempFile &&
+            outputCodec == getCodec(codec) && outputRate == getFrameRate() &&
+            fileExtension(outputFile) == fileExtension(tempFile)) {
+        writer.release();
+        if (copyFile(tempFile, outputFile)) {
+            modify = false;
+            return;
+        }
+        // fall back to transcoding
+        setOutput(outputFile, outputCodec, outputRate);
+    }
+
     // save the current position
     long pos = curPos;
     
@@ -1097,9 +2752,15 @@ void VideoProcessor::writeOutput()
  */
 void VideoProcessor::revertVideo()
 {
+    // stop is left unset when playing or processing has finished
+    bool ended = !isStop();
+
     // pause the video
-    jumpTo(0);    
-    curPos = 0;
     pauseIt();
+
+    // show the first frame again
+    if (ended)
+        showFrameAt(0);
+    jumpTo(0);
     emit updateProgressBar();
 }
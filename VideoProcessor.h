@@ -26,16 +26,61 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include <QObject>
 #include <QDateTime>
+#include <QDir>
 #include <vector>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "SpatialFilter.h"
+#include "TemporalFilter.h"
+#include "TemporalFFT.h"
+#include "TimeSeries.h"
+#include "ScratchFile.h"
+#include "FrameQueue.h"
+#include "FrameCache.h"
+#include "FrameSource.h"
+#include "VideoProbe.h"
+#include "StageProfiler.h"
+#include "BandCache.h"
+#include "Precision.h"
+#include "RieszMagnifier.h"
+
+enum spatialFilterType {LAPLACIAN, GAUSSIAN, RIESZ};
+enum temporalFilterType {IIR, IDEAL, BUTTERWORTH};
+
+// statistics of the running playback
+struct PlaybackStats {
+    // frames shown per second, measured over about a second
+    double fps;
+    // number of frames shown
+    long shown;
+    // number of late frames skipped
+    long dropped;
+};
 
-enum spatialFilterType {LAPLACIAN, GAUSSIAN};
-enum temporalFilterType {IIR, IDEAL};
+// progress of a running magnification
+struct ProcessProgress {
+    // what is being done, 0 before the first frame
+    const char *stage;
+    // frames done in this stage
+    long frames;
+    // of the video length
+    double percent;
+    // frames per second in this stage
+    double fps;
+    // seconds left in this stage, negative if unknown
+    double remaining;
+};
 
 class VideoProcessor : public QObject {
 
@@ -47,6 +92,8 @@ public:
 
     explicit VideoProcessor(QObject *parent = 0);
 
+    ~VideoProcessor();
+
     // Is the player playing?
     bool isStop();
 
@@ -97,6 +144,9 @@ public:
     // get current temp file
     void getCurTempFile(std::string &);
 
+    // the video a color or motion magnification would start from
+    std::string getSourceFile(bool color);
+
     // go to this position expressed in fraction of total film length
     bool setRelativePosition(double pos);
 
@@ -107,6 +157,14 @@ public:
     // by default the same parameters than input video will be used
     bool setOutput(const std::string &filename, int codec=0, double framerate=0.0, bool isColor=true);
 
+    // write the next magnification straight to a video file instead
+    // of a temp file, 0 means MJPG
+    void setDirectOutput(const std::string &filename, int codec=0);
+
+    // keep temp files as lossless frame stores, or as MJPG videos,
+    // stores by default only if they are compressed
+    void setLosslessTemp(bool lossless);
+
     // set the output as a series of image files
     // extension must be ".jpg", ".bmp" ...
     bool setOutput(const std::string &filename, // filename prefix
@@ -114,12 +172,86 @@ public:
                    int numberOfDigits=3,   // number of digits
                    int startIndex=0);       // start index
 
+    // set the amplification factor
+    void setAlpha(float a);
+
+    // set the cut-off spatial wavelength
+    void setLambdaC(float l);
+
+    // set the low and high temporal cut-offs
+    void setCutoffs(float low, float high);
+
+    // set the attenuation of the I, Q channels
+    void setChromAttenuation(float attenuation);
+
+    // set the levels of the spatial pyramids
+    void setLevels(int l);
+
     // set spatial filter
     void setSpatialFilter(spatialFilterType type);
 
     // set temporal filter
     void setTemporalFilter(temporalFilterType type);
 
+    // set the pyramid of motion magnification, LAPLACIAN or RIESZ
+    void setMotionFilter(spatialFilterType type);
+
+    // set the temporal filter of color magnification, IDEAL or BUTTERWORTH
+    void setColorFilter(temporalFilterType type);
+
+    // set the order of the Butterworth filter
+    void setFilterOrder(int order);
+
+    // process color magnification in bounded sliding windows
+    void setStreaming(bool s);
+
+    // set the sliding window length in frames
+    // 0 means choose one from the frame rate and low cut-off
+    void setStreamWindow(int frames);
+
+    // set the capacity of the queues between pipeline stages
+    void setPipelineDepth(int depth);
+
+    // set the number of frames decoded ahead of the shown one
+    void setPlaybackBuffer(int frames);
+
+    // set the memory of the decoded frame cache in bytes
+    // 0 disables the cache
+    void setCacheBudget(size_t bytes);
+
+    // set the tile size of motion magnification
+    // 0 means no tiling, negative a size chosen from the pyramid levels
+    void setTileSize(int size);
+
+    // set the precision of the IIR states and the buffered frames
+    void setPrecision(storagePrecision p);
+
+    // set the memory ceiling of color magnification in bytes,
+    // beyond it the frames are spilled to scratch files
+    // 0 means half of the physical memory
+    void setMemoryLimit(size_t bytes);
+
+    // set the directory of the scratch files
+    // empty means the temp directory of the system
+    void setScratchDir(const std::string &dir);
+
+    // keep the bandpassed levels of a run, so that the next run with
+    // other gains skips the filtering, off by default
+    void setBandCaching(bool enabled);
+
+    // the stage timings, disabled until setEnabled(true)
+    std::shared_ptr<StageProfiler> getProfiler();
+
+    // record the stage timings into another profiler
+    void setProfiler(const std::shared_ptr<StageProfiler> &p);
+
+    // queue statistics of the last motion magnification
+    QueueStats getDecodeQueueStats();
+    QueueStats getEncodeQueueStats();
+
+    // statistics of the running or the last playback
+    PlaybackStats getPlaybackStats();
+
     // play the frames of the sequence
     void playIt();
 
@@ -129,6 +261,15 @@ public:
     // Stop playing
     void stopIt();
 
+    // cancel the processing, safe from any thread
+    void cancelIt();
+
+    // clear the stop flag, before starting a processing
+    void clearCancel();
+
+    // progress of the processing, safe from any thread
+    ProcessProgress getProcessProgress();
+
     // display the prev frame of the sequence
     void prevFrame();
 
@@ -138,6 +279,15 @@ public:
     // Jump to a position
     bool jumpTo(long index);
 
+    // show a frame, for stepping and scrubbing
+    bool showFrameAt(long index);
+
+    // get a frame by its index, through the frame cache
+    bool getFrame(long index, cv::Mat &frame);
+
+    // show a frame in the background, the newest request wins
+    void requestSeek(long index);
+
     // Jump to a position in milliseconds
     bool jumpToMS(double pos);
 
@@ -155,21 +305,20 @@ public:
 
 private slots:
     void revertVideo();
+    void resumePlayback();
 
 signals:
     void showFrame(cv::Mat frame);
     void revert();
-    void sleep(int msecs);
     void updateBtn();
     void updateProgressBar();
     void reload(const std::string &);
-    void updateProcessProgress(const std::string &message, int percent);
-    void closeProgressDialog();
+    void seeked();
 
 private:    
 
-    // the OpenCV video capture object
-    cv::VideoCapture capture;
+    // the video capture object, reads frame stores too
+    FrameSource capture;
 
     // delay between each frame processing
     int delay;
@@ -179,16 +328,14 @@ private:
     long fnumber;
     // total number of frames
     long length;
-    // to stop the player
-    bool stop;
+    // to stop the player, may be set from another thread
+    std::atomic<bool> stop;
     // is the video modified
     bool modify;
-    // the current playing pos
-    long curPos;
+    // the current playing pos, written by the player thread
+    std::atomic<long> curPos;
     // current index for output images
     int curIndex;
-    // current level of pyramid
-    int curLevel;
     // number of digits in output image filename
     int digits;    
     // extension of output images
@@ -215,24 +362,106 @@ private:
     float exaggeration_factor;
     // lambda
     float lambda;
-    // the OpenCV video writer object
-    cv::VideoWriter writer;
-    cv::VideoWriter tempWriter;
+    // pyramid of motion magnification
+    spatialFilterType motionFilter;
+    // temporal filter of color magnification
+    temporalFilterType colorFilter;
+    // order of the Butterworth filter
+    int filterOrder;
+    // is color magnification streamed
+    bool streaming;
+    // sliding window length of the streaming mode
+    int streamWindow;
+    // capacity of the pipeline queues
+    int pipelineDepth;
+    // number of frames decoded ahead during playback
+    int playbackBuffer;
+    // tile size of motion magnification, 0 for none, negative for automatic
+    int tileSize;
+    // precision of the IIR states and the buffered frames
+    storagePrecision precision;
+    // memory ceiling of color magnification, 0 for automatic
+    size_t memoryLimit;
+    // directory of the scratch files
+    std::string scratchDir;
+    // timings of the processing stages
+    std::shared_ptr<StageProfiler> profiler;
+    // statistics of the decoded and to-be-encoded frame queues
+    QueueStats decodeStats;
+    QueueStats encodeStats;
+    // thread of the playback
+    std::thread player;
+    // statistics of the playback
+    std::atomic<long> shownFrames;
+    std::atomic<long> droppedFrames;
+    std::atomic<double> playbackFps;
+    // decoded frames around the playhead
+    FrameCache frameCache;
+    // thread of the background seeks
+    std::thread seeker;
+    std::mutex seekLock;
+    std::condition_variable seekWake;
+    std::condition_variable seekIdle;
+    // the newest frame asked for, -1 for none
+    std::atomic<long> seekTarget;
+    // is the seeker decoding
+    bool seekBusy;
+    bool seekQuit;
+    // was playing when the seeks began
+    bool resumeAfterSeek;
+    // progress of the processing, published for polling
+    std::atomic<long> progressFrames;
+    std::atomic<const char *> progressStage;
+    // steady clock ticks at the start of the stage
+    std::atomic<long long> progressStart;
+    // the video writer objects
+    FrameSink writer;
+    FrameSink tempWriter;
 
     // output filename
     std::string outputFile;
+    // codec and frame rate of the output video
+    int outputCodec;
+    double outputRate;
+    // the next magnification writes straight to this file
+    std::string directFile;
+    int directCodec;
+    // temp files are frame stores rather than MJPG videos
+    bool losslessTemp;
     // temp filename
     std::string tempFile;
     // all temp files queue
     std::vector<std::string> tempFileList;
+    // result of the last magnification and the video it came from
+    std::string lastRender;
+    std::string lastRenderSource;
+    // the video and modified flag before the current run
+    std::string renderInput;
+    bool renderModified;
+
+    // bandpassed levels of the last magnification
+    BandCache bandCache;
+    // are the bandpassed levels recorded
+    bool bandCaching;
+
+    // pyramid buffers kept across frames
+    PyramidWorkspace workspace;
+
+    // FFT engine of the ideal bandpass filter
+    TemporalFFT temporalFFT;
 
     // low pass filters for IIR
     std::vector<cv::Mat> lowpass1;
     std::vector<cv::Mat> lowpass2;
 
-    // recalculate the number of frames in video
-    // normally doesn't need it unless getLength()
-    // can't return a valid value
+    // filters and amplifies row strips of pyramid levels in parallel
+    class LevelFilter;
+
+    // magnifies the tiles of a frame in parallel
+    class TileFilter;
+
+    // get the exact number of frames and frame rate of the
+    // input, from the container when possible
     void calculateLength();
 
     // get the next frame if any
@@ -241,6 +470,33 @@ private:
     // to write the output frame
     void writeNextFrame(cv::Mat& frame);
 
+    // decode stage of the processing pipeline
+    void decodeStage(FrameQueue<cv::Mat> *queue);
+
+    // encode stage of the processing pipeline
+    void encodeStage(FrameQueue<cv::Mat> *queue);
+
+    // start the player thread from the current position
+    void startPlayback();
+
+    // stop and join the player thread
+    void stopPlayback();
+
+    // the player thread, shows the frames at their deadlines
+    void playStage();
+
+    // the seeker thread, serves the newest requestSeek()
+    void seekStage();
+
+    // drop the pending seek and wait for the seeker
+    void waitSeek();
+
+    // publish the progress of the processing
+    void reportProgress(const char *stage, long frame);
+
+    // getFrame(), optionally given up for a newer seek
+    bool decodeFrame(long index, cv::Mat &frame, bool cancellable);
+
     // set the temp video file
     // by default the same parameters to the input video
     bool createTemp(double framerate=0.0, bool isColor=true);
@@ -254,14 +510,27 @@ private:
 
     // temporal IIR filtering
     void temporalIIRFilter(const cv::Mat &src,
-                        cv::Mat &dst);
+                           cv::Mat &dst,
+                           cv::Mat &lowpassHi,
+                           cv::Mat &lowpassLo,
+                           float gain = 1.0f);
 
     // temporal ideal bandpass filtering
     void temporalIdealFilter(const cv::Mat &src,
                              cv::Mat &dst);
 
+    // ideal bandpass filtering without normalization
+    void idealBandpass(const cv::Mat &src,
+                       cv::Mat &dst);
+
     // amplify motion
-    void amplify(const cv::Mat &src, cv::Mat &dst);
+    void amplify(const cv::Mat &src, cv::Mat &dst, float factor);
+
+    // amplification factor of a laplacian pyramid level
+    float bandAmplification(int level, float lambda);
+
+    // amplification factors of all the laplacian pyramid levels
+    void bandFactors(const cv::Size &frameSize, std::vector<float> &factors);
 
     // attenuate I, Q channels
     void attenuate(cv::Mat &src, cv::Mat &dst);
@@ -270,10 +539,33 @@ private:
     void concat(const std::vector<cv::Mat> &frames, cv::Mat &dst);
 
     // de-concat the concatnate image into frames
-    void deConcat(const cv::Mat &src, const cv::Size &frameSize, std::vector<cv::Mat> &frames);
+    void deConcat(const cv::Mat &src, const cv::Size &frameSize, std::vector<cv::Mat> &frames,
+                  cv::Mat storage = cv::Mat());
+
+    // the memory limit in bytes, resolving 0 to its default
+    size_t effectiveMemoryLimit();
+
+    // does a working set of the given size exceed the memory limit
+    bool exceedsMemoryLimit(size_t bytes);
+
+    // reopen the source of the last result if its bands are cached,
+    // return the video to magnify
+    std::string renderSource(bool color);
+
+    // make the temp file the video, or drop it after a cancelled run
+    void finishRender(const std::string &source, bool keep);
+
+    // add an up-sampled color motion to a frame
+    void composeColorFrame(const cv::Mat &frame, const cv::Mat &motion, cv::Mat &output);
+
+    // color magnification over a sliding window
+    void colorMagnifyStreaming();
+
+    // color magnification with a causal Butterworth filter, frame by frame
+    void colorMagnifyButterworth();
 
-    // create an ideal bandpass processor
-    void createIdealBandpassFilter(cv::Mat &filter, double fl, double fh, double rate);
+    // phase-based motion magnification with a Riesz pyramid
+    void motionMagnifyRiesz();
 };
 
 #endif // VIDEOPROCESSOR_H
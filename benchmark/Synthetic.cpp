@@ -0,0 +1,146 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include "Synthetic.h"
+#include <math.h>
+#include <opencv2/highgui/highgui.hpp>
+
+// wavelength of the moving sinusoid in pixels
+static const double STRIPE_WAVELENGTH = 64.0;
+// peak displacement of the moving sinusoid in pixels
+static const double STRIPE_SHIFT = 0.5;
+// peak change of the red channel of the pulsing patch
+static const double PATCH_PULSE = 4.0;
+
+/**
+ * syntheticFrame	-	render a frame of a synthetic clip
+ *
+ * MOVING_SINUSOID: gray vertical stripes shifting sideways by
+ * STRIPE_SHIFT pixels at SYNTHETIC_FREQ.
+ * PULSING_PATCH: a fixed texture whose central patch has its red
+ * channel pulsing by PATCH_PULSE levels at SYNTHETIC_FREQ.
+ * The frames only depend on their arguments.
+ *
+ * @param kind	-	kind of clip
+ * @param size	-	frame size
+ * @param t     -	frame index
+ * @param frame	-	destinate frame, CV_8UC3
+ */
+void syntheticFrame(syntheticKind kind, const cv::Size &size, int t, cv::Mat &frame)
+{
+    double phase = 2 * CV_PI * SYNTHETIC_FREQ * t / SYNTHETIC_RATE;
+    frame.create(size, CV_8UC3);
+
+    if (kind == MOVING_SINUSOID) {
+        double shift = STRIPE_SHIFT * sin(phase);
+        std::vector<uchar> row(size.width);
+        for (int x = 0; x < size.width; ++x)
+            row[x] = cv::saturate_cast<uchar>(
+                    128 + 64 * sin(2 * CV_PI * (x - shift) / STRIPE_WAVELENGTH));
+        for (int y = 0; y < size.height; ++y) {
+            uchar *p = frame.ptr<uchar>(y);
+            for (int x = 0; x < size.width; ++x)
+                p[3*x] = p[3*x+1] = p[3*x+2] = row[x];
+        }
+        return;
+    }
+
+    // the same texture in every frame
+    cv::RNG rng(12345);
+    rng.fill(frame, cv::RNG::UNIFORM, cv::Scalar::all(96), cv::Scalar::all(160));
+    cv::Rect patch(size.width / 4, size.height / 4, size.width / 2, size.height / 2);
+    cv::Mat roi = frame(patch);
+    cv::add(roi, cv::Scalar(0, 0, 32 + PATCH_PULSE * sin(phase)), roi);
+}
+
+/**
+ * writeSyntheticClip	-	write a synthetic clip to a file
+ *
+ * @param fileName	-	the destinate avi
+ * @param kind      -	kind of clip
+ * @param size      -	frame size
+ * @param frames	-	number of frames
+ *
+ * @return true if success
+ */
+bool writeSyntheticClip(const std::string &fileName, syntheticKind kind,
+                        const cv::Size &size, int frames)
+{
+    cv::VideoWriter writer(fileName, CV_FOURCC('M', 'J', 'P', 'G'),
+                           SYNTHETIC_RATE, size, true);
+    if (!writer.isOpened())
+        return false;
+    cv::Mat frame;
+    for (int t = 0; t < frames; ++t) {
+        syntheticFrame(kind, size, t, frame);
+        writer.write(frame);
+    }
+    return true;
+}
+
+/**
+ * amplitudeAt	-	amplitude of a time series at a frequency
+ *
+ * @param series	-	samples, the mean is removed
+ * @param freq      -	frequency in Hz
+ * @param rate      -	sampling rate in Hz
+ *
+ * @return the amplitude of the sinusoid at freq
+ */
+double amplitudeAt(const std::vector<double> &series, double freq, double rate)
+{
+    size_t n = series.size();
+    if (n == 0)
+        return 0;
+    double mean = 0;
+    for (size_t t = 0; t < n; ++t)
+        mean += series[t];
+    mean /= n;
+    double re = 0, im = 0;
+    for (size_t t = 0; t < n; ++t) {
+        double w = 2 * CV_PI * freq * t / rate;
+        re += (series[t] - mean) * cos(w);
+        im -= (series[t] - mean) * sin(w);
+    }
+    return 2 * sqrt(re * re + im * im) / n;
+}
+
+/**
+ * dominantFrequency	-	frequency with the largest amplitude
+ *
+ * @param series	-	samples
+ * @param rate      -	sampling rate in Hz
+ * @param from      -	lowest frequency searched
+ * @param to        -	highest frequency searched
+ *
+ * @return the frequency, scanned in steps of 0.05 Hz
+ */
+double dominantFrequency(const std::vector<double> &series, double rate,
+                         double from, double to)
+{
+    double best = from, bestAmplitude = -1;
+    for (double f = from; f <= to; f += 0.05) {
+        double a = amplitudeAt(series, f, rate);
+        if (a > bestAmplitude) {
+            bestAmplitude = a;
+            best = f;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,48 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+enum syntheticKind {MOVING_SINUSOID, PULSING_PATCH};
+
+// frame rate of the synthetic clips
+static const double SYNTHETIC_RATE = 30.0;
+// frequency of the injected motion and color change, in Hz
+static const double SYNTHETIC_FREQ = 1.0;
+
+// render frame t of a synthetic clip, CV_8UC3
+void syntheticFrame(syntheticKind kind, const cv::Size &size, int t, cv::Mat &frame);
+
+// write a synthetic clip as an MJPG avi
+bool writeSyntheticClip(const std::string &fileName, syntheticKind kind,
+                        const cv::Size &size, int frames);
+
+// amplitude of a time series at a frequency, in the units of the samples
+double amplitudeAt(const std::vector<double> &series, double freq, double rate);
+
+// frequency of the largest amplitude between two frequencies
+double dominantFrequency(const std::vector<double> &series, double rate,
+                         double from, double to);
+
+#endif // SYNTHETIC_H
@@ -0,0 +1,52 @@
+#-------------------------------------------------
+#
+# Benchmarks of the EVM kernels and pipelines
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = evmbench
+TEMPLATE = app
+
+CONFIG += console c++11 thread
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    Synthetic.cpp \
+    ../VideoProcessor.cpp \
+    ../SpatialFilter.cpp \
+    ../TemporalFilter.cpp \
+    ../Precision.cpp \
+    ../RieszMagnifier.cpp \
+    ../TemporalFFT.cpp \
+    ../TimeSeries.cpp \
+    ../ScratchFile.cpp \
+    ../StageProfiler.cpp \
+    ../BandCache.cpp \
+    ../FrameCache.cpp \
+    ../FrameStore.cpp \
+    ../FrameSource.cpp \
+    ../VideoProbe.cpp
+
+HEADERS += Synthetic.h \
+    ../VideoProcessor.h \
+    ../SpatialFilter.h \
+    ../TemporalFilter.h \
+    ../Precision.h \
+    ../RieszMagnifier.h \
+    ../TemporalFFT.h \
+    ../TimeSeries.h \
+    ../ScratchFile.h \
+    ../StageProfiler.h \
+    ../BandCache.h \
+    ../FrameCache.h \
+    ../FrameStore.h \
+    ../FrameSource.h \
+    ../VideoProbe.h \
+    ../FrameQueue.h
+
+include(../opencv.pri)
@@ -0,0 +1,868 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/resource.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "SpatialFilter.h"
+#include "TemporalFilter.h"
+#include "TemporalFFT.h"
+#include "TimeSeries.h"
+#include "Precision.h"
+#include "RieszMagnifier.h"
+#include "VideoProcessor.h"
+#include "Synthetic.h"
+
+// low and high cut-off, as in VideoProcessor
+static const float FL = 0.05f;
+static const float FH = 0.4f;
+// pyramid levels, as in VideoProcessor
+static const int LEVELS = 4;
+
+// one line of the results
+struct BenchResult {
+    std::string bench;
+    std::string resolution;
+    double fps;
+    double bytesPerFrame;
+    long peakRssKB;
+    std::string quality;
+    double value;
+    bool passed;
+};
+
+// a resolution of the synthetic clips
+struct Resolution {
+    const char *name;
+    cv::Size size;
+};
+
+static const Resolution RESOLUTIONS[] = {
+    {"480p", cv::Size(640, 480)},
+    {"720p", cv::Size(1280, 720)},
+    {"1080p", cv::Size(1920, 1080)},
+    {"4k", cv::Size(3840, 2160)},
+};
+
+// the reduced precisions, compared against FULL_PRECISION
+struct PrecisionName {
+    storagePrecision precision;
+    const char *name;
+};
+
+static const PrecisionName REDUCED[] = {
+    {HALF_PRECISION, "half"},
+    {FIXED_PRECISION, "fixed"},
+};
+
+static std::vector<BenchResult> results;
+
+/**
+ * resetPeakRss	-	start measuring the peak RSS from now
+ *
+ * Only Linux can reset it, elsewhere the peak is over the process.
+ */
+static void resetPeakRss()
+{
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+#endif
+}
+
+/**
+ * peakRssKB	-	peak resident set size
+ *
+ * @return the peak since resetPeakRss() in KB
+ */
+static long peakRssKB()
+{
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), f))
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+                break;
+        fclose(f);
+        if (kb >= 0)
+            return kb;
+    }
+#endif
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/**
+ * seconds	-	time since an arbitrary origin
+ */
+static double seconds()
+{
+    return cv::getTickCount() / cv::getTickFrequency();
+}
+
+/**
+ * report	-	keep and print a result
+ */
+static void report(const char *bench, const char *resolution, int frames,
+                   double elapsed, double bytesPerFrame,
+                   const char *quality, double value, bool passed)
+{
+    BenchResult r;
+    r.bench = bench;
+    r.resolution = resolution;
+    r.fps = elapsed > 0 ? frames / elapsed : 0;
+    r.bytesPerFrame = bytesPerFrame;
+    r.peakRssKB = peakRssKB();
+    r.quality = quality;
+    r.value = value;
+    r.passed = passed;
+    results.push_back(r);
+    printf("%-12s %-6s %10.1f %12.0f %10ld  %-16s %12.6g %s\n",
+           bench, resolution, r.fps, bytesPerFrame, r.peakRssKB,
+           quality, value, passed ? "ok" : "FAIL");
+    fflush(stdout);
+}
+
+/**
+ * writeJson	-	write the results as a JSON array
+ *
+ * @param fileName	-	the destinate file, "-" for stdout
+ *
+ * @return true if success
+ */
+static bool writeJson(const std::string &fileName)
+{
+    FILE *f = fileName == "-" ? stdout : fopen(fileName.c_str(), "w");
+    if (!f) {
+        perror(fileName.c_str());
+        return false;
+    }
+    fprintf(f, "[");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &r = results[i];
+        fprintf(f, "%s\n{\"bench\":\"%s\",\"resolution\":\"%s\",\"fps\":%.3f,"
+                "\"bytes_per_frame\":%.0f,\"peak_rss_kb\":%ld,"
+                "\"quality\":\"%s\",\"value\":%.9g,\"passed\":%s}",
+                i ? "," : "", r.bench.c_str(), r.resolution.c_str(), r.fps,
+                r.bytesPerFrame, r.peakRssKB, r.quality.c_str(), r.value,
+                r.passed ? "true" : "false");
+    }
+    fprintf(f, "\n]\n");
+    if (f != stdout)
+        fclose(f);
+    return true;
+}
+
+/**
+ * iirExpression	-	the IIR bandpass step written with Mat expressions,
+ *                      as VideoProcessor did before the fused kernel
+ */
+static void iirExpression(const cv::Mat &src, cv::Mat &lowpassHi,
+                          cv::Mat &lowpassLo, cv::Mat &dst)
+{
+    cv::Mat temp1 = (1-FH)*lowpassHi + FH*src;
+    cv::Mat temp2 = (1-FL)*lowpassLo + FL*src;
+    lowpassHi = temp1;
+    lowpassLo = temp2;
+    dst = lowpassHi - lowpassLo;
+}
+
+/**
+ * meanDrift	-	largest difference between the channel means of two images
+ */
+static double meanDrift(const cv::Mat &a, const cv::Mat &b)
+{
+    cv::Scalar ma = cv::mean(a), mb = cv::mean(b);
+    double drift = 0;
+    for (int c = 0; c < a.channels(); ++c)
+        drift = std::max(drift, fabs(ma[c] - mb[c]));
+    return drift;
+}
+
+/**
+ * psnr	-	peak signal to noise ratio from a sum of squared errors
+ *
+ * Identical signals give 100 dB.
+ */
+static double psnr(double squaredError, double count, double peak)
+{
+    if (squaredError <= 0 || count <= 0)
+        return 100;
+    return std::min(10 * log10(peak * peak * count / squaredError), 100.0);
+}
+
+/**
+ * floatFrames	-	synthetic frames as CV_32FC3 in [0, 1]
+ */
+static void floatFrames(syntheticKind kind, const cv::Size &size, int count,
+                        std::vector<cv::Mat> &frames)
+{
+    frames.resize(count);
+    cv::Mat frame;
+    for (int t = 0; t < count; ++t) {
+        syntheticFrame(kind, size, t, frame);
+        frame.convertTo(frames[t], CV_32FC3, 1.0/255.0);
+    }
+}
+
+/**
+ * benchSpatial	-	time the pyramid functions
+ *
+ * The quality is how well the pyramids give back the frame.
+ */
+static void benchSpatial(const Resolution &res, int iterations)
+{
+    std::vector<cv::Mat> frames;
+    floatFrames(MOVING_SINUSOID, res.size, 4, frames);
+    double bytes = frames[0].total() * frames[0].elemSize();
+    PyramidWorkspace workspace;
+    std::vector<cv::Mat> pyramid;
+    cv::Mat dst;
+
+    resetPeakRss();
+    double start = seconds();
+    for (int i = 0; i < iterations; ++i)
+        buildLaplacianPyramid(frames[i % frames.size()], LEVELS, pyramid, workspace);
+    double elapsed = seconds() - start;
+    reconImgFromLaplacianPyramid(pyramid, LEVELS, dst, workspace);
+    double error = cv::norm(dst, frames[(iterations - 1) % frames.size()], cv::NORM_INF);
+    report("laplacian", res.name, iterations, elapsed, bytes,
+           "recon_max_error", error, error < 1e-4);
+
+    resetPeakRss();
+    start = seconds();
+    for (int i = 0; i < iterations; ++i)
+        reconImgFromLaplacianPyramid(pyramid, LEVELS, dst, workspace);
+    elapsed = seconds() - start;
+    report("recon", res.name, iterations, elapsed, bytes,
+           "recon_max_error", error, error < 1e-4);
+
+    std::vector<cv::Mat> gaussian;
+    resetPeakRss();
+    start = seconds();
+    for (int i = 0; i < iterations; ++i)
+        buildGaussianPyramid(frames[i % frames.size()], LEVELS, gaussian);
+    elapsed = seconds() - start;
+    // blurring and down-sampling keep the mean
+    const cv::Mat &last = frames[(iterations - 1) % frames.size()];
+    double drift = meanDrift(gaussian.at(LEVELS-1), last);
+    report("gaussian", res.name, iterations, elapsed, bytes,
+           "mean_drift", drift, drift < 1e-2);
+
+    resetPeakRss();
+    start = seconds();
+    for (int i = 0; i < iterations; ++i)
+        upsamplingFromGaussianPyramid(gaussian.at(LEVELS-1), LEVELS, dst, workspace);
+    elapsed = seconds() - start;
+    cv::resize(dst, dst, last.size());
+    drift = meanDrift(dst, last);
+    report("upsampling", res.name, iterations, elapsed, bytes,
+           "mean_drift", drift, drift < 1e-2);
+}
+
+/**
+ * benchIIR	-	time the fused IIR bandpass step
+ *
+ * The quality is the difference to the Mat expression version,
+ * which is timed too: its row reports the speedup of the fused step.
+ */
+static void benchIIR(const Resolution &res, int iterations)
+{
+    std::vector<cv::Mat> frames;
+    floatFrames(MOVING_SINUSOID, res.size, 8, frames);
+    double bytes = frames[0].total() * frames[0].elemSize();
+
+    cv::Mat lowpassHi = frames[0].clone();
+    cv::Mat lowpassLo = frames[0].clone();
+    cv::Mat dst(res.size, CV_32FC3);
+    resetPeakRss();
+    double start = seconds();
+    for (int i = 0; i < iterations; ++i)
+        iirBandpass(frames[i % frames.size()], lowpassHi, lowpassLo, dst, FL, FH);
+    double elapsed = seconds() - start;
+
+    cv::Mat refHi = frames[0].clone();
+    cv::Mat refLo = frames[0].clone();
+    cv::Mat ref;
+    resetPeakRss();
+    start = seconds();
+    for (int i = 0; i < iterations; ++i)
+        iirExpression(frames[i % frames.size()], refHi, refLo, ref);
+    double expression = seconds() - start;
+    double error = cv::norm(dst, ref, cv::NORM_INF);
+    report("iir", res.name, iterations, elapsed, bytes,
+           "max_error", error, error < 1e-4);
+    double speedup = elapsed > 0 ? expression / elapsed : 0;
+    report("iir_expression", res.name, iterations, expression, bytes,
+           "speedup", speedup, speedup > 1);
+}
+
+/**
+ * benchPrecision	-	time the IIR step with reduced precision states
+ *
+ * Runs on the laplacian levels of Lab frames, as motionMagnify does.
+ * The quality is the PSNR of the band against the float states,
+ * with the range of L (100) as the peak.
+ */
+static void benchPrecision(const Resolution &res, int iterations)
+{
+    std::vector<cv::Mat> frames;
+    floatFrames(MOVING_SINUSOID, res.size, 8, frames);
+    PyramidWorkspace workspace;
+    std::vector<cv::Mat> levels(frames.size());
+    std::vector<cv::Mat> pyramid;
+    for (size_t t = 0; t < frames.size(); ++t) {
+        cv::cvtColor(frames[t], frames[t], CV_BGR2Lab);
+        buildLaplacianPyramid(frames[t], LEVELS, pyramid, workspace);
+        levels[t] = pyramid.at(1).clone();
+    }
+
+    cv::Mat refHi = levels[0].clone();
+    cv::Mat refLo = levels[0].clone();
+    cv::Mat ref(levels[0].size(), CV_32FC3);
+    for (int i = 0; i < iterations; ++i)
+        iirBandpass(levels[i % levels.size()], refHi, refLo, ref, FL, FH);
+
+    for (size_t p = 0; p < sizeof(REDUCED) / sizeof(REDUCED[0]); ++p) {
+        cv::Mat lowpassHi, lowpassLo;
+        packImage(levels[0], lowpassHi, REDUCED[p].precision);
+        packImage(levels[0], lowpassLo, REDUCED[p].precision);
+        double bytes = 2.0 * lowpassHi.total() * lowpassHi.elemSize();
+        cv::Mat dst(levels[0].size(), CV_32FC3);
+        resetPeakRss();
+        double start = seconds();
+        for (int i = 0; i < iterations; ++i)
+            iirBandpass(levels[i % levels.size()], lowpassHi, lowpassLo, dst, FL, FH);
+        double elapsed = seconds() - start;
+
+        double error = cv::norm(dst, ref, cv::NORM_L2);
+        double value = psnr(error * error, dst.total() * dst.channels(), 100);
+        std::string bench = std::string("iir_") + REDUCED[p].name;
+        report(bench.c_str(), res.name, iterations, elapsed, bytes,
+               "band_psnr", value, value > 40);
+    }
+}
+
+/**
+ * benchRiesz	-	time the phase-based magnification of the luminance
+ *
+ * Real time is SYNTHETIC_RATE frames per second, which is required
+ * up to 720p; larger sizes are only reported.
+ */
+static void benchRiesz(const Resolution &res, int iterations)
+{
+    std::vector<cv::Mat> frames;
+    floatFrames(MOVING_SINUSOID, res.size, 8, frames);
+    cv::Mat luma;
+    for (size_t t = 0; t < frames.size(); ++t) {
+        cv::cvtColor(frames[t], frames[t], CV_BGR2Lab);
+        cv::extractChannel(frames[t], luma, 0);
+        frames[t] = luma.clone();
+    }
+    double bytes = frames[0].total() * frames[0].elemSize();
+    RieszMagnifier magnifier;
+    magnifier.setLevels(LEVELS);
+    magnifier.setCutoffs(FL, FH);
+    cv::Mat dst;
+
+    resetPeakRss();
+    double start = seconds();
+    for (int i = 0; i < iterations; ++i)
+        magnifier.magnify(frames[i % frames.size()], dst);
+    double elapsed = seconds() - start;
+    double fps = elapsed > 0 ? iterations / elapsed : 0;
+    double ratio = fps / SYNTHETIC_RATE;
+    report("riesz", res.name, iterations, elapsed, bytes,
+           "realtime_ratio", ratio, res.size.height > 720 || ratio >= 1);
+}
+
+/**
+ * benchTemporal	-	time the ideal filter and concat/de-concat
+ *                      on the coarse levels of a pulsing patch
+ *
+ * The quality of the filter is the gain of the injected pulse,
+ * which is inside the band.
+ */
+static void benchTemporal(const Resolution &res, int frames)
+{
+    // one frame at a time, full 4k clips don't fit in RAM
+    std::vector<cv::Mat> coarse(frames);
+    std::vector<cv::Mat> pyramid;
+    cv::Mat frame, input;
+    for (int t = 0; t < frames; ++t) {
+        syntheticFrame(PULSING_PATCH, res.size, t, frame);
+        frame.convertTo(input, CV_32FC3, 1.0/255.0);
+        buildGaussianPyramid(input, LEVELS, pyramid);
+        coarse[t] = pyramid.at(LEVELS-1).clone();
+    }
+    cv::Size coarseSize = coarse[0].size();
+    double bytes = coarse[0].total() * coarse[0].elemSize();
+
+    // concat and de-concat
+    resetPeakRss();
+    double start = seconds();
+    TimeSeriesBuffer buffer;
+    buffer.create(coarseSize, coarse[0].type(), frames);
+    for (int t = 0; t < frames; ++t)
+        buffer.push(coarse[t]);
+    cv::Mat series = buffer.series();
+    double elapsed = seconds() - start;
+    report("concat", res.name, frames, elapsed, bytes, "-", 0, true);
+
+    std::vector<cv::Mat> back;
+    resetPeakRss();
+    start = seconds();
+    seriesToFrames(series, coarseSize, back);
+    elapsed = seconds() - start;
+    double error = 0;
+    for (int t = 0; t < frames; ++t)
+        error = std::max(error, cv::norm(back[t], coarse[t], cv::NORM_INF));
+    report("deconcat", res.name, frames, elapsed, bytes,
+           "roundtrip_error", error, error == 0);
+
+    // ideal bandpass around the pulse
+    TemporalFFT fft;
+    cv::Mat filtered;
+    double fl = SYNTHETIC_FREQ * 0.8, fh = SYNTHETIC_FREQ * 1.2;
+    fft.idealBandpass(series, filtered, fl, fh, SYNTHETIC_RATE);
+
+    // red channel of the patch centre, before and after
+    int centre = (coarseSize.height / 2) * coarseSize.width + coarseSize.width / 2;
+    std::vector<double> in(frames), out(frames);
+    for (int t = 0; t < frames; ++t) {
+        in[t] = series.at<cv::Vec3f>(centre, t)[2];
+        out[t] = filtered.at<cv::Vec3f>(centre, t)[2];
+    }
+    double gain = amplitudeAt(out, SYNTHETIC_FREQ, SYNTHETIC_RATE)
+            / amplitudeAt(in, SYNTHETIC_FREQ, SYNTHETIC_RATE);
+
+    // timed as temporalIdealFilter, with the normalization
+    resetPeakRss();
+    start = seconds();
+    fft.idealBandpass(series, filtered, fl, fh, SYNTHETIC_RATE);
+    cv::normalize(filtered, filtered, 0, 1, CV_MINMAX);
+    elapsed = seconds() - start;
+    report("ideal", res.name, frames, elapsed, bytes,
+           "band_gain", gain, gain > 0.7 && gain < 1.3);
+}
+
+/**
+ * readChannel	-	mean of a channel over a region of every frame
+ */
+static bool readChannel(const std::string &fileName, const cv::Rect &region,
+                        int channel, std::vector<double> &series)
+{
+    FrameSource capture(fileName);
+    if (!capture.isOpened())
+        return false;
+    cv::Mat frame;
+    series.clear();
+    while (capture.read(frame))
+        series.push_back(cv::mean(frame(region))[channel]);
+    return !series.empty();
+}
+
+/**
+ * temporalDeviation	-	mean over the pixels of a row of their
+ *                          temporal standard deviation
+ */
+static double temporalDeviation(const std::string &fileName, int row)
+{
+    FrameSource capture(fileName);
+    cv::Mat frame, sum, sq, f;
+    int n = 0;
+    while (capture.read(frame)) {
+        frame.row(row).convertTo(f, CV_64FC3);
+        if (n == 0) {
+            sum = cv::Mat::zeros(f.size(), f.type());
+            sq = sum.clone();
+        }
+        sum += f;
+        sq += f.mul(f);
+        ++n;
+    }
+    if (n == 0)
+        return 0;
+    cv::Mat var = sq / n - (sum / n).mul(sum / n);
+    cv::Mat deviation;
+    cv::sqrt(cv::max(var, 0), deviation);
+    return cv::mean(deviation)[0];
+}
+
+/**
+ * removeTempFiles	-	remove the temp files of a processor
+ */
+static void removeTempFiles(VideoProcessor &processor)
+{
+    std::string temp;
+    while (true) {
+        processor.getTempFile(temp);
+        if (temp.empty())
+            break;
+        remove(temp.c_str());
+    }
+}
+
+/**
+ * videoPSNR	-	PSNR of a video against a reference video
+ */
+static double videoPSNR(const std::string &fileName, const std::string &reference)
+{
+    FrameSource capture(fileName), referenceCapture(reference);
+    cv::Mat frame, referenceFrame;
+    double squaredError = 0, count = 0;
+    while (capture.read(frame) && referenceCapture.read(referenceFrame)) {
+        double error = cv::norm(frame, referenceFrame, cv::NORM_L2);
+        squaredError += error * error;
+        count += frame.total() * frame.channels();
+    }
+    return count > 0 ? psnr(squaredError, count, 255) : 0;
+}
+
+/**
+ * maxFrameDiff	-	largest difference between the frames of two videos
+ *
+ * @return 255 if they don't have the same number of frames
+ */
+static double maxFrameDiff(const std::string &fileName, const std::string &reference)
+{
+    FrameSource capture(fileName), referenceCapture(reference);
+    cv::Mat frame, referenceFrame;
+    double diff = 0;
+    while (true) {
+        bool more = capture.read(frame);
+        if (more != referenceCapture.read(referenceFrame))
+            return 255;
+        if (!more)
+            return diff;
+        diff = std::max(diff, cv::norm(frame, referenceFrame, cv::NORM_INF));
+    }
+}
+
+/**
+ * pulseGain	-	gain of the pulse of the patch, and the dominant
+ *                  frequency of the output
+ */
+static double pulseGain(const Resolution &res, const std::string &clip,
+                        const std::string &output, double &peak)
+{
+    cv::Rect patch(res.size.width * 3 / 8, res.size.height * 3 / 8,
+                   res.size.width / 4, res.size.height / 4);
+    std::vector<double> in, out;
+    peak = 0;
+    if (!readChannel(clip, patch, 2, in) || !readChannel(output, patch, 2, out))
+        return 0;
+    peak = dominantFrequency(out, SYNTHETIC_RATE, 0.2, 5.0);
+    return amplitudeAt(out, SYNTHETIC_FREQ, SYNTHETIC_RATE)
+            / amplitudeAt(in, SYNTHETIC_FREQ, SYNTHETIC_RATE);
+}
+
+/**
+ * runMagnify	-	magnify a synthetic clip, timed
+ *
+ * @return the seconds it took
+ */
+static double runMagnify(VideoProcessor &processor, const std::string &clip,
+                         bool color, storagePrecision precision)
+{
+    processor.setInput(clip);
+    processor.setPrecision(precision);
+    if (color) {
+        processor.setAlpha(50);
+        processor.setCutoffs(SYNTHETIC_FREQ * 0.8, SYNTHETIC_FREQ * 1.2);
+    }
+    resetPeakRss();
+    processor.clearCancel();
+    double start = seconds();
+    if (color)
+        processor.colorMagnify();
+    else
+        processor.motionMagnify();
+    return seconds() - start;
+}
+
+/**
+ * benchReduced	-	time a pipeline with the reduced precisions
+ *
+ * The quality is the PSNR of the output against the float output.
+ */
+static void benchReduced(const Resolution &res, const std::string &clip, int frames,
+                         bool color, const std::string &reference)
+{
+    double bytes = 3.0 * res.size.area();
+    for (size_t p = 0; p < sizeof(REDUCED) / sizeof(REDUCED[0]); ++p) {
+        VideoProcessor processor;
+        double elapsed = runMagnify(processor, clip, color, REDUCED[p].precision);
+        std::string output;
+        processor.getCurTempFile(output);
+        double value = videoPSNR(output, reference);
+        std::string bench = std::string(color ? "color_" : "motion_") + REDUCED[p].name;
+        report(bench.c_str(), res.name, frames, elapsed, bytes,
+               "psnr", value, value > 30);
+        removeTempFiles(processor);
+    }
+}
+
+/**
+ * stepBack	-	step from the last frame back to the first
+ *
+ * @param count	-	number of frames of the clip
+ * @param frames	-	the frames, last first
+ *
+ * @return the elapsed seconds
+ */
+static double stepBack(VideoProcessor &processor, int count, std::vector<cv::Mat> &frames)
+{
+    frames.clear();
+    double start = seconds();
+    for (long i = count - 1; i >= 0; --i) {
+        cv::Mat frame;
+        if (!processor.getFrame(i, frame))
+            break;
+        frames.push_back(frame);
+    }
+    return seconds() - start;
+}
+
+/**
+ * benchSeek	-	time stepping back through a clip
+ *
+ * Once with the frame cache and once seeking for every frame.
+ * The quality is the largest difference between the two.
+ */
+static void benchSeek(const Resolution &res, const std::string &clip, int frames)
+{
+    double bytes = 3.0 * res.size.area();
+    VideoProcessor cached, uncached;
+    cached.setInput(clip);
+    uncached.setInput(clip);
+    uncached.setCacheBudget(0);
+
+    std::vector<cv::Mat> cachedFrames, seekedFrames;
+    resetPeakRss();
+    double elapsed = stepBack(cached, frames, cachedFrames);
+    double seekElapsed = stepBack(uncached, frames, seekedFrames);
+
+    double diff = cachedFrames.size() == seekedFrames.size() ? 0 : 255;
+    for (size_t i = 0; i < cachedFrames.size() && i < seekedFrames.size(); ++i)
+        diff = std::max(diff, cv::norm(cachedFrames[i], seekedFrames[i], cv::NORM_INF));
+    report("step_cached", res.name, frames, elapsed, bytes,
+           "max_diff", diff, diff == 0);
+    report("step_seek", res.name, frames, seekElapsed, bytes,
+           "max_diff", diff, diff == 0);
+}
+
+/**
+ * benchStreamAlign	-	check the frames of streaming color magnification
+ *
+ * With a zero gain the output frame t is the full resolution frame
+ * which band t was added to, so the output only matches the batch
+ * output if the two decoders of the streaming mode line up, and
+ * no frame is dropped at the end.
+ */
+static void benchStreamAlign(const Resolution &res, const std::string &clip, int frames)
+{
+    double bytes = 3.0 * res.size.area();
+    VideoProcessor batch, stream;
+    batch.setInput(clip);
+    batch.setAlpha(0);
+    batch.clearCancel();
+    batch.colorMagnify();
+    stream.setInput(clip);
+    stream.setAlpha(0);
+    stream.setStreaming(true);
+    stream.clearCancel();
+    resetPeakRss();
+    double start = seconds();
+    stream.colorMagnify();
+    double elapsed = seconds() - start;
+
+    std::string batchOutput, streamOutput;
+    batch.getCurTempFile(batchOutput);
+    stream.getCurTempFile(streamOutput);
+    double diff = maxFrameDiff(streamOutput, batchOutput);
+    report("stream_align", res.name, frames, elapsed, bytes,
+           "max_diff", diff, diff <= 1);
+    removeTempFiles(batch);
+    removeTempFiles(stream);
+}
+
+/**
+ * benchPipeline	-	time motionMagnify and colorMagnify end to end
+ *
+ * The quality is the gain of the injected motion or pulse.
+ */
+static void benchPipeline(const Resolution &res, int frames)
+{
+    double bytes = 3.0 * res.size.area();
+    std::string clip = std::string("bench_") + res.name + ".avi";
+
+    // motion
+    if (writeSyntheticClip(clip, MOVING_SINUSOID, res.size, frames)) {
+        VideoProcessor processor;
+        double elapsed = runMagnify(processor, clip, false, FULL_PRECISION);
+        std::string output;
+        processor.getCurTempFile(output);
+        int row = res.size.height / 2;
+        double gain = temporalDeviation(output, row) / temporalDeviation(clip, row);
+        report("motion", res.name, frames, elapsed, bytes,
+               "motion_gain", gain, gain > 1.5);
+        benchReduced(res, clip, frames, false, output);
+
+        // tiled, which must match the untiled output within one level;
+        // both are kept lossless so that MJPG noise can't hide a seam
+        VideoProcessor untiled, tiled;
+        untiled.setLosslessTemp(true);
+        runMagnify(untiled, clip, false, FULL_PRECISION);
+        tiled.setLosslessTemp(true);
+        tiled.setTileSize(-1);
+        elapsed = runMagnify(tiled, clip, false, FULL_PRECISION);
+        std::string untiledOutput, tiledOutput;
+        untiled.getCurTempFile(untiledOutput);
+        tiled.getCurTempFile(tiledOutput);
+        double diff = maxFrameDiff(tiledOutput, untiledOutput);
+        report("motion_tiled", res.name, frames, elapsed, bytes,
+               "max_diff", diff, diff <= 1);
+        removeTempFiles(tiled);
+        removeTempFiles(untiled);
+        removeTempFiles(processor);
+
+        // the phase-based method, on the same clip
+        VideoProcessor riesz;
+        riesz.setMotionFilter(RIESZ);
+        elapsed = runMagnify(riesz, clip, false, FULL_PRECISION);
+        riesz.getCurTempFile(output);
+        gain = temporalDeviation(output, row) / temporalDeviation(clip, row);
+        report("motion_riesz", res.name, frames, elapsed, bytes,
+               "motion_gain", gain, gain > 1.5);
+        removeTempFiles(riesz);
+
+        benchSeek(res, clip, frames);
+        benchStreamAlign(res, clip, frames);
+    }
+
+    // color
+    if (writeSyntheticClip(clip, PULSING_PATCH, res.size, frames)) {
+        VideoProcessor processor;
+        double elapsed = runMagnify(processor, clip, true, FULL_PRECISION);
+        std::string output;
+        processor.getCurTempFile(output);
+        double peak;
+        double gain = pulseGain(res, clip, output, peak);
+        report("color", res.name, frames, elapsed, bytes,
+               "pulse_gain", gain, gain > 2 && fabs(peak - SYNTHETIC_FREQ) < 0.2);
+        benchReduced(res, clip, frames, true, output);
+        removeTempFiles(processor);
+
+        // the causal filter, frame by frame
+        VideoProcessor causal;
+        causal.setColorFilter(BUTTERWORTH);
+        elapsed = runMagnify(causal, clip, true, FULL_PRECISION);
+        causal.getCurTempFile(output);
+        gain = pulseGain(res, clip, output, peak);
+        report("color_bw", res.name, frames, elapsed, bytes,
+               "pulse_gain", gain, gain > 2 && fabs(peak - SYNTHETIC_FREQ) < 0.2);
+        removeTempFiles(causal);
+    }
+    remove(clip.c_str());
+}
+
+/**
+ * usage	-	print the usage of the benchmark
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--iterations N] [--frames N] [--sizes 480p,720p,1080p,4k]\n"
+            "          [--only kernels|pipeline] [--json FILE]\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = 100;
+    int frames = 90;
+    std::string sizes = "480p,720p,1080p,4k";
+    std::string only;
+    std::string json;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--iterations")
+            iterations = std::max(atoi(argv[i+1]), 1);
+        else if (arg == "--frames")
+            frames = std::max(atoi(argv[i+1]), 8);
+        else if (arg == "--sizes")
+            sizes = argv[i+1];
+        else if (arg == "--only")
+            only = argv[i+1];
+        else if (arg == "--json")
+            json = argv[i+1];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argc % 2 == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("%-12s %-6s %10s %12s %10s  %-16s %12s\n", "bench", "size",
+           "frames/s", "bytes/frame", "peak KB", "quality", "value");
+    for (size_t r = 0; r < sizeof(RESOLUTIONS) / sizeof(RESOLUTIONS[0]); ++r) {
+        const Resolution &res = RESOLUTIONS[r];
+        if (("," + sizes + ",").find(std::string(",") + res.name + ",") == std::string::npos)
+            continue;
+        if (only != "pipeline") {
+            benchSpatial(res, iterations);
+            benchIIR(res, iterations);
+            benchPrecision(res, iterations);
+            benchRiesz(res, iterations);
+            benchTemporal(res, frames);
+        }
+        if (only != "kernels")
+            benchPipeline(res, frames);
+    }
+
+    if (!json.empty() && !writeJson(json))
+        return 1;
+
+    for (size_t i = 0; i < results.size(); ++i)
+        if (!results[i].passed)
+            return 1;
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Yet anther C++ implementation of EVM, based on OpenCV and Qt.
+// Copyright (C) 2014  Joseph Pan <cs.wzpan@gmail.com>
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "BatchEngine.h"
+
+/**
+ * usage	-	print the usage of the command
+ *
+ * @param name	-	name of the executable
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] input output\n"
+            "       %s [options] --manifest jobs.txt\n"
+            "\n"
+            "options:\n"
+            "  --mode motion|color  magnification mode (motion)\n"
+            "  --alpha A            amplification factor (10)\n"
+            "  --lambda-c L         cut-off wavelength (80)\n"
+            "  --fl F               low cut-off (0.05)\n"
+            "  --fh F               high cut-off (0.4)\n"
+            "  --chrom C            chromatic attenuation (0.1)\n"
+            "  --levels N           pyramid levels (4)\n"
+            "  --precision P        full, half or fixed storage (full)\n"
+            "  --pyramid P          laplacian or riesz motion pyramid (laplacian)\n"
+            "  --filter F           ideal or butterworth color filter (ideal)\n"
+            "  --order N            order of the butterworth filter (2)\n"
+            "  --streaming on|off   ideal color filter in bounded sliding\n"
+            "                       windows, alpha is not normalized (off)\n"
+            "  --threads N          total threads of all jobs, 3 per running job\n"
+            "                       and the rest for OpenCV (all cores)\n"
+            "  --memory MB          total memory of all jobs (half of RAM)\n"
+            "  --trace FILE         write the stage timings as Chrome trace JSON\n"
+            "  --profile on         print p50/p95/p99 of each stage\n"
+            "\n"
+            "A manifest has one job per line: input, output and optional\n"
+            "parameters as mode=, alpha=, lambda_c=, fl=, fh=, chrom=, levels=,\n"
+            "precision=, pyramid=, filter=, order=, streaming=.\n"
+            "The options above are the defaults of its jobs.\n",
+            name, name);
+}
+
+int main(int argc, char *argv[])
+{
+    BatchEngine engine;
+    MagnifyJob defaults;
+    std::string manifest;
+    std::string trace;
+    bool profile = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            files.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--manifest") {
+            manifest = value;
+        } else if (arg == "--trace") {
+            trace = value;
+        } else if (arg == "--profile") {
+            profile = (value == "on" || value == "1");
+        } else if (arg == "--threads") {
+            engine.setMaxThreads(atoi(value.c_str()));
+        } else if (arg == "--memory") {
+            engine.setMemoryLimit((size_t)atol(value.c_str()) << 20);
+        } else {
+            // --lambda-c is lambda_c in a manifest
+            std::string key = arg.substr(2);
+            if (key == "lambda-c")
+                key = "lambda_c";
+            if (!BatchEngine::parseParameter(key + "=" + value, defaults)) {
+                fprintf(stderr, "invalid option: %s %s\n", arg.c_str(), value.c_str());
+                return 2;
+            }
+        }
+    }
+
+    if (!manifest.empty() && files.empty()) {
+        if (!engine.loadManifest(manifest, defaults))
+            return 2;
+    } else if (manifest.empty() && files.size() == 2) {
+        MagnifyJob job = defaults;
+        job.input = files[0];
+        job.output = files[1];
+        engine.addJob(job);
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::shared_ptr<StageProfiler> profiler = engine.getProfiler();
+    profiler->setEnabled(profile || !trace.empty());
+
+    int failed = engine.run();
+
+    if (profile)
+        printf("%s", profiler->summary().c_str());
+    if (!trace.empty() && !profiler->writeChromeTrace(trace))
+        return 1;
+    return failed == 0 ? 0 : 1;
+}
@@ -42,21 +42,33 @@ MainWindow::MainWindow(QWidget *parent) :
     // magnify dialog
     magnifyDialog = 0;
 
+    // the magnifier's progress is polled at a fixed rate
+    magnifying = false;
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(100);
+    connect(progressTimer, SIGNAL(timeout()), this, SLOT(pollProgress()));
+
     updateStatus(false);
 
     video = new VideoProcessor;
+    // the runs of the magnify dialogs tune the gains of one video
+    video->setBandCaching(true);
+
+    display = new FrameDisplay(this);
 
     connect(video, SIGNAL(showFrame(cv::Mat)), this, SLOT(showFrame(cv::Mat)));
-    connect(video, SIGNAL(sleep(int)), this, SLOT(sleep(int)));
+    connect(display, SIGNAL(ready()), this, SLOT(displayFrame()));
     connect(video, SIGNAL(revert()), this, SLOT(revert()));
     connect(video, SIGNAL(updateBtn()), this, SLOT(updateBtn()));
     connect(video, SIGNAL(updateProgressBar()), this, SLOT(updateProgressBar()));
-    connect(video, SIGNAL(updateProcessProgress(std::string, int)), this, SLOT(updateProcessProgress(std::string, int)));
-    connect(video, SIGNAL(closeProgressDialog()), this, SLOT(closeProgressDialog()));
 }
 
 MainWindow::~MainWindow()
 {
+    if (magnifier.joinable()) {
+        video->cancelIt();
+        magnifier.join();
+    }
     delete ui;
 }
 
@@ -271,41 +283,38 @@ bool MainWindow::LoadFile(const QString &fileName)
 
 
 /** 
- * showImage	-	show a image
+ * showFrame	-	show a frame
  *
- * @param image	-	the image to be showed
+ * The frame is scaled to the view and converted on the
+ * display's worker, then shown by displayFrame().
  *
- * Mainly used for display a single frame
+ * @param frame	-	the frame to be showed
  */
 void MainWindow::showFrame(cv::Mat frame)
 {
-    cv::Mat tmp;
-    cvtColor(frame, tmp, CV_BGR2RGB);
-    QImage img = QImage((const unsigned char*)(tmp.data),
-                        tmp.cols, tmp.rows, QImage::Format_RGB888);
-
-    ui->videoLabel->setPixmap(QPixmap::fromImage(img));
-    ui->videoLabel->repaint();
+    QSize view = ui->scrollArea->viewport()->size();
+    display->submit(frame, view.width(), view.height());
 }
 
-
-/** 
- * revert	-	do something when revert playing
+/**
+ * displayFrame	-	display the latest converted frame
  *
  */
-void MainWindow::revert()
+void MainWindow::displayFrame()
 {
-    updateBtn();
+    QPixmap pixmap;
+    if (display->take(pixmap))
+        ui->videoLabel->setPixmap(pixmap);
 }
 
+
 /** 
- * sleep	-	pause the video for several msecs
+ * revert	-	do something when revert playing
  *
- * @param msecs 
  */
-void MainWindow::sleep(int msecs)
+void MainWindow::revert()
 {
-    helper->sleep(msecs);
+    updateBtn();
 }
 
 /** 
@@ -334,30 +343,108 @@ void MainWindow::updateProgressBar()
 
     // update the time label
     updateTimeLabel();
+
+    // achieved frame rate of the playback
+    if (!video->isStop()) {
+        PlaybackStats stats = video->getPlaybackStats();
+        rateLabel->setText(tr("Frame rate: %1 (playing %2, %3 dropped)")
+                           .arg(video->getFrameRate())
+                           .arg(stats.fps, 0, 'f', 1)
+                           .arg(stats.dropped));
+    }
 }
 
 
 /**
- * updateProgressBar	-	update the process progress dialog
+ * pollProgress	-	show the progress of the magnifier
  *
+ * Runs on progressTimer while the magnifier is running.
  */
-void MainWindow::updateProcessProgress(const std::string &message, int value)
-{
-    if(!progressDialog){
-        progressDialog = new QProgressDialog(this);
-        progressDialog->setLabelText(QString::fromStdString(message));
-        progressDialog->setRange(0, 100);
-        progressDialog->setModal(true);
-        progressDialog->setCancelButtonText(tr("Abort"));
-        progressDialog->show();
-        progressDialog->raise();
-        progressDialog->activateWindow();
+void MainWindow::pollProgress()
+{
+    if (!magnifying) {
+        finishMagnify();
+        return;
     }
-    progressDialog->setValue(value + 1);
-    qApp->processEvents();
-    if (progressDialog->wasCanceled()){
-        video->stopIt();
+
+    if (progressDialog->wasCanceled()) {
+        progressDialog->setLabelText(tr("Aborting..."));
+        video->cancelIt();
+        return;
     }
+
+    ProcessProgress progress = video->getProcessProgress();
+    if (!progress.stage)
+        return;
+    QString label = QString::fromLatin1(progress.stage);
+    if (progress.remaining >= 0)
+        label += tr("\n%1 frames/s, %2 s left")
+                .arg(progress.fps, 0, 'f', 1)
+                .arg(progress.remaining, 0, 'f', 0);
+    progressDialog->setLabelText(label);
+    // reaching the maximum would reset the dialog
+    progressDialog->setValue(std::min(static_cast<int>(progress.percent), 99));
+}
+
+/**
+ * startMagnify	-	start a magnification on the magnifier thread
+ *
+ * @param mode	-	motion or color magnification
+ */
+void MainWindow::startMagnify(magnifyMode mode)
+{
+    // the player and the seeker share the capture
+    video->pauseIt();
+    // from now on, an abort reaches the magnifier
+    video->clearCancel();
+
+    // change the cursor
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    progressDialog = new QProgressDialog(this);
+    progressDialog->setLabelText(tr("Processing..."));
+    progressDialog->setRange(0, 100);
+    progressDialog->setModal(true);
+    progressDialog->setCancelButtonText(tr("Abort"));
+    progressDialog->show();
+    progressDialog->raise();
+    progressDialog->activateWindow();
+
+    magnifying = true;
+    magnifier = std::thread(&MainWindow::magnifyStage, this, mode);
+    progressTimer->start();
+}
+
+/**
+ * magnifyStage	-	the magnifier thread
+ *
+ * @param mode	-	motion or color magnification
+ */
+void MainWindow::magnifyStage(magnifyMode mode)
+{
+    if (mode == COLOR_MAGNIFY)
+        video->colorMagnify();
+    else
+        video->motionMagnify();
+    magnifying = false;
+}
+
+/**
+ * finishMagnify	-	clean up after the magnifier
+ *
+ */
+void MainWindow::finishMagnify()
+{
+    progressTimer->stop();
+    magnifier.join();
+    closeProgressDialog();
+
+    // restore the cursor
+    QApplication::restoreOverrideCursor();
+
+    // update the buttons and the progress
+    updateBtn();
+    updateProgressBar();
 }
 
 /**
@@ -385,7 +472,7 @@ void MainWindow::on_actionOpen_triggered()
     QString fileName = QFileDialog::getOpenFileName(this,
                                                     tr("Open Video"),
                                                     ".",
-                                                    tr("Video Files (*.avi *.mov *.mpeg *.mp4)"));
+                                                    tr("Video Files (*.avi *.mov *.mpeg *.mp4 *.evmf)"));
     if(!fileName.isEmpty()) {
         if(LoadFile(fileName)){
             updateStatus(true);
@@ -487,7 +574,7 @@ void MainWindow::on_progressSlider_sliderMoved(int position)
 {
     long pos = position * video->getLength() /
             ui->progressSlider->maximum();
-    video->jumpTo(pos);
+    video->requestSeek(pos);
 
     updateTimeLabel();
 }
@@ -506,7 +593,7 @@ void MainWindow::on_actionClean_Temp_Files_triggered()
     QDir dir(path);
 
     // set filter
-    dir.setNameFilters(QStringList() << "temp*.avi");
+    dir.setNameFilters(QStringList() << "temp*.avi" << "temp*" FRAME_STORE_EXT);
     dir.setFilter(QDir::Files);
     std::string temp;
 
@@ -525,18 +612,13 @@ void MainWindow::on_motion_triggered()
     if (!magnifyDialog)
         magnifyDialog = new MagnifyDialog(this, video);
 
+    magnifyDialog->prepare(MOTION_MAGNIFY);
     magnifyDialog->show();
     magnifyDialog->raise();
     magnifyDialog->activateWindow();
 
-    if (magnifyDialog->exec() == QDialog::Accepted) {
-        // change the cursor
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-        // run the process
-        video->motionMagnify();
-        // restore the cursor
-        QApplication::restoreOverrideCursor();
-    }
+    if (magnifyDialog->exec() == QDialog::Accepted)
+        startMagnify(MOTION_MAGNIFY);
 }
 
 // color (motion) magnification
@@ -546,16 +628,11 @@ void MainWindow::on_color_triggered()
     if (!magnifyDialog)
         magnifyDialog = new MagnifyDialog(this, video);
 
+    magnifyDialog->prepare(COLOR_MAGNIFY);
     magnifyDialog->show();
     magnifyDialog->raise();
     magnifyDialog->activateWindow();
 
-    if (magnifyDialog->exec() == QDialog::Accepted) {
-        // change the cursor
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-        // run the process
-        video->colorMagnify();
-        // restore the cursor
-        QApplication::restoreOverrideCursor();
-    }
+    if (magnifyDialog->exec() == QDialog::Accepted)
+        startMagnify(COLOR_MAGNIFY);
 }
@@ -29,10 +29,13 @@
 #include <QMessageBox>
 #include <QProgressDialog>
 #include <QLabel>
+#include <QTimer>
 #include <queue>
+#include <thread>
+#include <atomic>
 #include "VideoProcessor.h"
 #include "MagnifyDialog.h"
-#include "WindowHelper.h"
+#include "FrameDisplay.h"
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -96,15 +99,16 @@ private slots:
 
     void showFrame(cv::Mat frame);      // show a frame
 
+    void displayFrame();                // display a converted frame
+
     void revert();                      // revert playing
 
-    void sleep(int msecs);              // sleep for a while
 
     void updateBtn();                   // update button status
 
     void updateProgressBar();           // update progress bar
 
-    void updateProcessProgress(const std::string &message, int value);  // update process progress
+    void pollProgress();                // poll the magnification progress
 
     void on_progressSlider_sliderMoved(int position);
 
@@ -141,9 +145,24 @@ private:
     // video processor instance
     VideoProcessor *video;
 
-    // a window helper with some useful
-    // functions e.g. sleep
-    WindowHelper *helper;
+    // converts the frames for display off the GUI thread
+    FrameDisplay *display;
+
+    // runs the magnification off the GUI thread
+    std::thread magnifier;
+    // is the magnifier still running
+    std::atomic<bool> magnifying;
+    // polls the progress of the magnifier
+    QTimer *progressTimer;
+
+    // start a magnification on the magnifier
+    void startMagnify(magnifyMode mode);
+
+    // the magnifier thread
+    void magnifyStage(magnifyMode mode);
+
+    // clean up after the magnifier
+    void finishMagnify();
 
     // for cleaning temp files
     void clean();
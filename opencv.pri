@@ -0,0 +1,21 @@
+# OpenCV and optional dependencies, shared by all the targets
+
+unix {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += opencv
+}
+Win32 {
+INCLUDEPATH += C:\OpenCV2.2\include\
+LIBS += -LC:\OpenCV2.2\lib \
+    -lopencv_core220 \
+    -lopencv_highgui220 \
+    -lopencv_imgproc220 \
+    -lopencv_features2d220 \
+    -lopencv_calib3d220
+}
+
+# optional LZ4 compression of the frame stores, qmake CONFIG+=lz4
+lz4 {
+    DEFINES += EVM_HAVE_LZ4
+    LIBS += -llz4
+}